@@ -15,7 +15,20 @@
  * <http://www.gnu.org/licenses/>.
  */
 
+#include "Checksums.h"
+#include "CollisionProxy.h"
+#include "CompactMesh.h"
 #include "EntityCategories.h"
+#include "Erosion.h"
+#include "HeightNoise.h"
+#include "ImpostorAtlas.h"
+#include "ImpostorLod.h"
 #include "IslandFactory.h"
+#include "NavigationGrid.h"
+#include "OceanClipmap.h"
+#include "QuantizedHeightMap.h"
 #include "RockFactory.h"
+#include "SceneBatch.h"
+#include "StagingBuffer.h"
+#include "TerrainLighting.h"
 #include "TreeFactory.h"
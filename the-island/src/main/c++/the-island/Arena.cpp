@@ -0,0 +1,82 @@
+/*
+ * Copyright © 2014 Simple Entertainment Limited
+ *
+ * This file is part of The Island.
+ *
+ * The Island is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * The Island is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with The Island. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <algorithm>
+#include <cstdint>
+
+#include "Arena.h"
+
+using namespace std;
+
+namespace theisland
+{
+	Arena::Arena(size_t blockSize) :
+		blockSize(blockSize),
+		blocks(),
+		capacity(0),
+		end(nullptr),
+		position(nullptr)
+	{
+	}
+
+	void Arena::addBlock(size_t size)
+	{
+		blocks.push_back(unique_ptr<char[]>(new char[size]));
+		capacity += size;
+
+		position = blocks.back().get();
+		end = position + size;
+	}
+
+	void* Arena::allocate(size_t size, size_t alignment)
+	{
+		uintptr_t address = reinterpret_cast<uintptr_t>(position);
+		uintptr_t alignedAddress = (address + alignment - 1) & ~(alignment - 1);
+
+		if (position == nullptr || alignedAddress + size > reinterpret_cast<uintptr_t>(end))
+		{
+			addBlock(max(blockSize, size + alignment));
+
+			address = reinterpret_cast<uintptr_t>(position);
+			alignedAddress = (address + alignment - 1) & ~(alignment - 1);
+		}
+
+		position = reinterpret_cast<char*>(alignedAddress + size);
+
+		return reinterpret_cast<void*>(alignedAddress);
+	}
+
+	void Arena::release()
+	{
+		if (blocks.empty())
+		{
+			return;
+		}
+
+		// Grow to a single block that fits everything this build needed so that the next build does not have to
+		// allocate any more blocks.
+		if (blocks.size() > 1)
+		{
+			size_t size = capacity;
+			blocks.clear();
+			capacity = 0;
+			addBlock(size);
+		}
+
+		position = blocks.front().get();
+		end = position + capacity;
+	}
+}
@@ -0,0 +1,116 @@
+/*
+ * Copyright © 2014 Simple Entertainment Limited
+ *
+ * This file is part of The Island.
+ *
+ * The Island is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * The Island is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with The Island. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#ifndef ARENA_H_
+#define ARENA_H_
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include <simplicity/API.h>
+
+namespace theisland
+{
+	/**
+	 * <p>
+	 * A monotonic allocator for data that only lives as long as something is being built. Allocations are never freed
+	 * individually, the whole arena is released in one go instead.
+	 * </p>
+	 */
+	class SIMPLE_API Arena
+	{
+		public:
+			Arena(std::size_t blockSize = 1 << 20);
+
+			void* allocate(std::size_t size, std::size_t alignment);
+
+			// Invalidates everything allocated from the arena. The memory is kept (in a single block) for the next
+			// build.
+			void release();
+
+		private:
+			std::size_t blockSize;
+
+			std::vector<std::unique_ptr<char[]>> blocks;
+
+			std::size_t capacity;
+
+			char* end;
+
+			char* position;
+
+			void addBlock(std::size_t size);
+	};
+
+	/**
+	 * <p>
+	 * Allows standard containers to allocate from an arena.
+	 * </p>
+	 */
+	template<typename T>
+	class ArenaAllocator
+	{
+		public:
+			typedef T value_type;
+
+			ArenaAllocator(Arena& arena) :
+				arena(&arena)
+			{
+			}
+
+			template<typename U>
+			ArenaAllocator(const ArenaAllocator<U>& other) :
+				arena(other.arena)
+			{
+			}
+
+			T* allocate(std::size_t count)
+			{
+				return static_cast<T*>(arena->allocate(count * sizeof(T), alignof(T)));
+			}
+
+			void deallocate(T*, std::size_t)
+			{
+			}
+
+			template<typename U>
+			bool operator==(const ArenaAllocator<U>& other) const
+			{
+				return arena == other.arena;
+			}
+
+			template<typename U>
+			bool operator!=(const ArenaAllocator<U>& other) const
+			{
+				return arena != other.arena;
+			}
+
+		private:
+			Arena* arena;
+
+			template<typename U>
+			friend class ArenaAllocator;
+	};
+
+	template<typename T>
+	using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+	// A map of values over a height map (one row per x coordinate) allocated from an arena.
+	typedef ArenaVector<ArenaVector<float>> ArenaMap;
+}
+
+#endif /* ARENA_H_ */
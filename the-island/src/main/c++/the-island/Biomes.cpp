@@ -0,0 +1,125 @@
+/*
+ * Copyright © 2014 Simple Entertainment Limited
+ *
+ * This file is part of The Island.
+ *
+ * The Island is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * The Island is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with The Island. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include "Biomes.h"
+
+using namespace simplicity;
+using namespace std;
+
+namespace theisland
+{
+	namespace Biomes
+	{
+		void classify(const MeshData& meshData, float cutoffHeight, ArenaVector<float>& flatnesses,
+				ArenaVector<float>& maxHeights, ArenaVector<unsigned char>& biomes)
+		{
+			unsigned int triangleCount = meshData.vertexCount / 3;
+			flatnesses.resize(triangleCount);
+			maxHeights.resize(triangleCount);
+			biomes.resize(triangleCount);
+
+			// Gather what the classification needs into flat arrays...
+			for (unsigned int triangle = 0; triangle < triangleCount; triangle++)
+			{
+				const Vertex* vertices = &meshData.vertexData[triangle * 3];
+
+				flatnesses[triangle] = vertices[0].normal.Y();
+				maxHeights[triangle] =
+						max(vertices[0].position.Y(), max(vertices[1].position.Y(), vertices[2].position.Y()));
+			}
+
+			// ... so that it can be classified without branches (and vectorized).
+			const float* flatnessData = flatnesses.data();
+			const float* maxHeightData = maxHeights.data();
+			unsigned char* biomeData = biomes.data();
+			for (unsigned int triangle = 0; triangle < triangleCount; triangle++)
+			{
+				biomeData[triangle] = getBiome(flatnessData[triangle], maxHeightData[triangle], cutoffHeight);
+			}
+		}
+
+		unsigned char getBiome(float flatness, float maxHeight, float cutoffHeight)
+		{
+			flatness = fabs(flatness);
+
+			unsigned char biome = GRASS;
+			biome = (flatness > 0.5f && maxHeight < 0.5f) || maxHeight < 0.0f ? BEACH : biome;
+			biome = maxHeight > 20.0f ? SNOW : biome;
+			biome = flatness < 0.2f ? CLIFF : biome;
+			biome = maxHeight < cutoffHeight ? SUBMERGED : biome;
+
+			return biome;
+		}
+
+		Vector4 getColor(unsigned char biome)
+		{
+			if (biome == BEACH)
+			{
+				return Vector4(0.83f, 0.65f, 0.15f, 1.0f);
+			}
+
+			if (biome == CLIFF)
+			{
+				return Vector4(0.6f, 0.6f, 0.6f, 1.0f);
+			}
+
+			if (biome == SNOW)
+			{
+				return Vector4(0.9f, 0.9f, 0.9f, 1.0f);
+			}
+
+			return Vector4(0.0f, 0.5f, 0.0f, 1.0f);
+		}
+
+		float getRockDensity(unsigned char biome)
+		{
+			if (biome == SUBMERGED)
+			{
+				return 0.0f;
+			}
+
+			return 0.05f;
+		}
+
+		float getTreeDensity(unsigned char biome)
+		{
+			if (biome == GRASS)
+			{
+				return 0.05f;
+			}
+
+			return 0.0f;
+		}
+
+		void sort(const ArenaVector<unsigned char>& biomes, ArenaVector<ArenaVector<unsigned int>>& buckets)
+		{
+			if (buckets.size() != BIOME_COUNT)
+			{
+				buckets.assign(BIOME_COUNT, ArenaVector<unsigned int>(buckets.get_allocator()));
+			}
+
+			for (ArenaVector<unsigned int>& bucket : buckets)
+			{
+				bucket.clear();
+			}
+
+			for (unsigned int triangle = 0; triangle < biomes.size(); triangle++)
+			{
+				buckets[biomes[triangle]].push_back(triangle * 3);
+			}
+		}
+	}
+}
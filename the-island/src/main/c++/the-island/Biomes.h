@@ -0,0 +1,57 @@
+/*
+ * Copyright © 2014 Simple Entertainment Limited
+ *
+ * This file is part of The Island.
+ *
+ * The Island is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * The Island is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with The Island. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#ifndef BIOMES_H_
+#define BIOMES_H_
+
+#include <simplicity/API.h>
+
+#include "Arena.h"
+
+namespace theisland
+{
+	namespace Biomes
+	{
+		static const unsigned char BEACH = 0;
+		static const unsigned char CLIFF = 1;
+		static const unsigned char GRASS = 2;
+		static const unsigned char SNOW = 3;
+		static const unsigned char SUBMERGED = 4;
+
+		static const unsigned int BIOME_COUNT = 5;
+
+		// Classifies every triangle of the mesh (three vertices per triangle) into a biome. The highest point of each
+		// triangle is kept too since it decides where foliage can grow. The flatnesses are only scratch space.
+		void classify(const simplicity::MeshData& meshData, float cutoffHeight, ArenaVector<float>& flatnesses,
+				ArenaVector<float>& maxHeights, ArenaVector<unsigned char>& biomes);
+
+		// Classifies a single triangle from the Y component of its normal and its highest point.
+		unsigned char getBiome(float flatness, float maxHeight, float cutoffHeight);
+
+		simplicity::Vector4 getColor(unsigned char biome);
+
+		// The number of rocks per square unit of the biome.
+		float getRockDensity(unsigned char biome);
+
+		// The number of trees per square unit of the biome.
+		float getTreeDensity(unsigned char biome);
+
+		// Sorts the triangles into a list of vertex indices per biome.
+		void sort(const ArenaVector<unsigned char>& biomes, ArenaVector<ArenaVector<unsigned int>>& buckets);
+	}
+}
+
+#endif /* BIOMES_H_ */
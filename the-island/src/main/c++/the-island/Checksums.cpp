@@ -0,0 +1,247 @@
+/*
+ * Copyright © 2014 Simple Entertainment Limited
+ *
+ * This file is part of The Island.
+ *
+ * The Island is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * The Island is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with The Island. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <sstream>
+
+#include "Checksums.h"
+
+using namespace simplicity;
+using namespace std;
+
+static const uint64_t FNV_PRIME = 1099511628211ull;
+
+namespace theisland
+{
+	namespace Checksums
+	{
+		template<size_t N>
+		uint64_t hashSorted(vector<array<int64_t, N>>& snappedInstances);
+		int64_t snap(float value, float tolerance);
+
+		vector<string> compare(const IslandChecksums& reference, const IslandChecksums& candidate)
+		{
+			vector<string> differences;
+
+			if (candidate.heightMap != reference.heightMap)
+			{
+				differences.push_back("height map");
+			}
+
+			if (candidate.chunks.size() != reference.chunks.size())
+			{
+				differences.push_back("chunk count");
+			}
+			else
+			{
+				for (unsigned int chunk = 0; chunk < reference.chunks.size(); chunk++)
+				{
+					if (candidate.chunks[chunk] != reference.chunks[chunk])
+					{
+						stringstream difference;
+						difference << "chunk " << chunk;
+						differences.push_back(difference.str());
+					}
+				}
+			}
+
+			if (candidate.biomeColors != reference.biomeColors)
+			{
+				differences.push_back("biome colors");
+			}
+
+			if (candidate.foliageBodies != reference.foliageBodies)
+			{
+				differences.push_back("foliage bodies");
+			}
+
+			if (candidate.grass != reference.grass)
+			{
+				differences.push_back("grass");
+			}
+
+			if (candidate.rocks != reference.rocks)
+			{
+				differences.push_back("rocks");
+			}
+
+			if (candidate.trees != reference.trees)
+			{
+				differences.push_back("trees");
+			}
+
+			return differences;
+		}
+
+		uint64_t hashColors(const MeshData& meshData, float tolerance, uint64_t hash)
+		{
+			for (unsigned int index = 0; index < meshData.vertexCount; index++)
+			{
+				const Vector4& color = meshData.vertexData[index].color;
+				for (unsigned int component = 0; component < 4; component++)
+				{
+					hash = hashValue(color[component], tolerance, hash);
+				}
+			}
+
+			return hash;
+		}
+
+		uint64_t hashHeightMap(const vector<vector<float>>& heightMap, float tolerance)
+		{
+			uint64_t hash = hashInteger(heightMap.size());
+			for (const vector<float>& row : heightMap)
+			{
+				hash = hashHeights(row.data(), row.size(), tolerance, hash);
+			}
+
+			return hash;
+		}
+
+		uint64_t hashHeights(const float* heights, unsigned int count, float tolerance, uint64_t hash)
+		{
+			for (unsigned int index = 0; index < count; index++)
+			{
+				hash = hashValue(heights[index], tolerance, hash);
+			}
+
+			return hash;
+		}
+
+		uint64_t hashInstances(const Vector3* positions, unsigned int count, float tolerance)
+		{
+			vector<array<int64_t, 3>> snappedPositions(count);
+			for (unsigned int index = 0; index < count; index++)
+			{
+				for (unsigned int axis = 0; axis < 3; axis++)
+				{
+					snappedPositions[index][axis] = snap(positions[index][axis], tolerance);
+				}
+			}
+
+			return hashSorted(snappedPositions);
+		}
+
+		uint64_t hashInteger(int64_t value, uint64_t hash)
+		{
+			// FNV-1a over the bytes from least to most significant so that the hash does not depend on the platform.
+			uint64_t bits = static_cast<uint64_t>(value);
+			for (unsigned int byte = 0; byte < 8; byte++)
+			{
+				hash ^= (bits >> (byte * 8)) & 0xff;
+				hash *= FNV_PRIME;
+			}
+
+			return hash;
+		}
+
+		uint64_t hashProxies(const CollisionProxy* proxies, unsigned int count, float tolerance)
+		{
+			vector<array<int64_t, 5>> snappedProxies(count);
+			for (unsigned int index = 0; index < count; index++)
+			{
+				const CollisionProxy& proxy = proxies[index];
+				for (unsigned int axis = 0; axis < 3; axis++)
+				{
+					snappedProxies[index][axis] = snap(proxy.position[axis], tolerance);
+				}
+				snappedProxies[index][3] = snap(proxy.height, tolerance);
+				snappedProxies[index][4] = snap(proxy.radius, tolerance);
+			}
+
+			return hashSorted(snappedProxies);
+		}
+
+		template<size_t N>
+		uint64_t hashSorted(vector<array<int64_t, N>>& snappedInstances)
+		{
+			sort(snappedInstances.begin(), snappedInstances.end());
+
+			uint64_t hash = hashInteger(snappedInstances.size());
+			for (const array<int64_t, N>& instance : snappedInstances)
+			{
+				for (int64_t value : instance)
+				{
+					hash = hashInteger(value, hash);
+				}
+			}
+
+			return hash;
+		}
+
+		uint64_t hashTriangles(const Triangle* triangles, unsigned int count, float tolerance)
+		{
+			vector<array<int64_t, 9>> snappedTriangles(count);
+			for (unsigned int index = 0; index < count; index++)
+			{
+				const Triangle& triangle = triangles[index];
+				const Vector3* points[] = { &triangle.getPointA(), &triangle.getPointB(), &triangle.getPointC() };
+				for (unsigned int point = 0; point < 3; point++)
+				{
+					for (unsigned int axis = 0; axis < 3; axis++)
+					{
+						snappedTriangles[index][point * 3 + axis] = snap((*points[point])[axis], tolerance);
+					}
+				}
+			}
+
+			return hashSorted(snappedTriangles);
+		}
+
+		uint64_t hashValue(float value, float tolerance, uint64_t hash)
+		{
+			return hashInteger(snap(value, tolerance), hash);
+		}
+
+		uint64_t hashVertices(const MeshData& meshData, float tolerance)
+		{
+			uint64_t hash = hashInteger(meshData.vertexCount);
+			for (unsigned int index = 0; index < meshData.vertexCount; index++)
+			{
+				const Vertex& vertex = meshData.vertexData[index];
+				for (unsigned int axis = 0; axis < 3; axis++)
+				{
+					hash = hashValue(vertex.position[axis], tolerance, hash);
+					hash = hashValue(vertex.normal[axis], tolerance, hash);
+				}
+			}
+
+			return hash;
+		}
+
+		int64_t snap(float value, float tolerance)
+		{
+			if (tolerance > 0.0f)
+			{
+				return static_cast<int64_t>(floor(value / tolerance + 0.5f));
+			}
+
+			// Positive and negative zero are the same value.
+			if (value == 0.0f)
+			{
+				return 0;
+			}
+
+			uint32_t bits;
+			memcpy(&bits, &value, sizeof(bits));
+
+			return bits;
+		}
+	}
+}
@@ -0,0 +1,98 @@
+/*
+ * Copyright © 2014 Simple Entertainment Limited
+ *
+ * This file is part of The Island.
+ *
+ * The Island is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * The Island is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with The Island. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#ifndef CHECKSUMS_H_
+#define CHECKSUMS_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <simplicity/API.h>
+
+#include "CollisionProxy.h"
+
+namespace theisland
+{
+	/**
+	 * <p>
+	 * Stable checksums of the parts of an island, for showing that two ways of generating it give the same island.
+	 * Values are snapped to a multiple of a tolerance before they are hashed. This is not a tolerance comparison:
+	 * the checksums only match if every value snaps to the same multiple, and two values closer together than the
+	 * tolerance still change the checksum if they land either side of a snapping boundary. A tolerance of 0 hashes
+	 * the exact values, which is what ways of generating an island that should be bit for bit the same are compared
+	 * with.
+	 * </p>
+	 */
+	namespace Checksums
+	{
+		static const std::uint64_t EMPTY = 14695981039346656037ull;
+
+		struct SIMPLE_API IslandChecksums
+		{
+			// The colors of the terrain of every chunk, which are the colors of their biomes.
+			std::uint64_t biomeColors = EMPTY;
+
+			// The positions and normals of the terrain of each chunk (EMPTY for chunks without terrain).
+			std::vector<std::uint64_t> chunks;
+
+			// The collision proxies of the rocks and trees the foliage bodies are built from.
+			std::uint64_t foliageBodies = EMPTY;
+
+			// The triangles grass grows on.
+			std::uint64_t grass = EMPTY;
+
+			std::uint64_t heightMap = EMPTY;
+
+			std::uint64_t rocks = EMPTY;
+
+			std::uint64_t trees = EMPTY;
+		};
+
+		// Describes every part of the candidate island that differs from the reference island (none if they are the
+		// same).
+		SIMPLE_API std::vector<std::string> compare(const IslandChecksums& reference, const IslandChecksums& candidate);
+
+		SIMPLE_API std::uint64_t hashColors(const simplicity::MeshData& meshData, float tolerance,
+				std::uint64_t hash = EMPTY);
+
+		SIMPLE_API std::uint64_t hashHeightMap(const std::vector<std::vector<float>>& heightMap, float tolerance);
+
+		// Hashes a run of heights onto the hash so far, for hashing a height map a row at a time (after hashing its
+		// edge length).
+		SIMPLE_API std::uint64_t hashHeights(const float* heights, unsigned int count, float tolerance,
+				std::uint64_t hash);
+
+		// The order of the instances does not matter.
+		SIMPLE_API std::uint64_t hashInstances(const simplicity::Vector3* positions, unsigned int count,
+				float tolerance);
+
+		SIMPLE_API std::uint64_t hashInteger(std::int64_t value, std::uint64_t hash = EMPTY);
+
+		// The order of the proxies does not matter.
+		SIMPLE_API std::uint64_t hashProxies(const CollisionProxy* proxies, unsigned int count, float tolerance);
+
+		// The order of the triangles does not matter.
+		SIMPLE_API std::uint64_t hashTriangles(const simplicity::Triangle* triangles, unsigned int count,
+				float tolerance);
+
+		SIMPLE_API std::uint64_t hashValue(float value, float tolerance, std::uint64_t hash = EMPTY);
+
+		SIMPLE_API std::uint64_t hashVertices(const simplicity::MeshData& meshData, float tolerance);
+	}
+}
+
+#endif /* CHECKSUMS_H_ */
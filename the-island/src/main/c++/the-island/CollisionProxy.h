@@ -0,0 +1,36 @@
+/*
+ * Copyright © 2014 Simple Entertainment Limited
+ *
+ * This file is part of The Island.
+ *
+ * The Island is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * The Island is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with The Island. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#ifndef COLLISIONPROXY_H_
+#define COLLISIONPROXY_H_
+
+#include <simplicity/API.h>
+
+namespace theisland
+{
+	// A cheap stand in for the collision shape of a piece of foliage. Proxies with no height are spheres, the others
+	// are upright capsules standing on their position.
+	struct CollisionProxy
+	{
+		float height;
+
+		simplicity::Vector3 position;
+
+		float radius;
+	};
+}
+
+#endif /* COLLISIONPROXY_H_ */
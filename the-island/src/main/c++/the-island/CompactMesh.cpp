@@ -0,0 +1,192 @@
+/*
+ * Copyright © 2014 Simple Entertainment Limited
+ *
+ * This file is part of The Island.
+ *
+ * The Island is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * The Island is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with The Island. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <algorithm>
+#include <cfloat>
+
+#include "CompactMesh.h"
+
+using namespace simplicity;
+using namespace std;
+
+namespace theisland
+{
+	CompactMesh::CompactMesh(const MeshData& meshData) :
+		origin(0.0f, 0.0f, 0.0f),
+		palette(),
+		scale(1.0f, 1.0f, 1.0f),
+		vertices(meshData.vertexCount)
+	{
+		Vector3 minimum(FLT_MAX, FLT_MAX, FLT_MAX);
+		Vector3 maximum(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+		for (unsigned int index = 0; index < meshData.vertexCount; index++)
+		{
+			for (unsigned int axis = 0; axis < 3; axis++)
+			{
+				minimum[axis] = min(minimum[axis], meshData.vertexData[index].position[axis]);
+				maximum[axis] = max(maximum[axis], meshData.vertexData[index].position[axis]);
+			}
+		}
+
+		if (meshData.vertexCount > 0)
+		{
+			origin = minimum;
+			for (unsigned int axis = 0; axis < 3; axis++)
+			{
+				scale[axis] = max(maximum[axis] - minimum[axis], FLT_EPSILON) / UINT16_MAX;
+			}
+		}
+
+		for (unsigned int index = 0; index < meshData.vertexCount; index++)
+		{
+			const simplicity::Vertex& vertex = meshData.vertexData[index];
+
+			for (unsigned int axis = 0; axis < 3; axis++)
+			{
+				vertices[index].position[axis] =
+						static_cast<uint16_t>((vertex.position[axis] - origin[axis]) / scale[axis] + 0.5f);
+			}
+
+			vertices[index].normal = packNormal(vertex.normal);
+			vertices[index].padding = 0;
+
+			// Meshes only use a handful of colors, the most recent of which is nearly always the one needed.
+			unsigned int paletteIndex = palette.size();
+			for (unsigned int searchIndex = palette.size(); searchIndex > 0; searchIndex--)
+			{
+				if (palette[searchIndex - 1] == vertex.color)
+				{
+					paletteIndex = searchIndex - 1;
+					break;
+				}
+			}
+
+			if (paletteIndex == palette.size() && palette.size() <= UINT8_MAX)
+			{
+				palette.push_back(vertex.color);
+			}
+
+			vertices[index].paletteIndex = min(paletteIndex, static_cast<unsigned int>(UINT8_MAX));
+		}
+	}
+
+	bool CompactMesh::fitsPalette(const MeshData& meshData)
+	{
+		vector<Vector4> colors;
+		for (unsigned int index = 0; index < meshData.vertexCount; index++)
+		{
+			const Vector4& color = meshData.vertexData[index].color;
+			if (find(colors.rbegin(), colors.rend(), color) != colors.rend())
+			{
+				continue;
+			}
+
+			if (colors.size() == UINT8_MAX + 1)
+			{
+				return false;
+			}
+
+			colors.push_back(color);
+		}
+
+		return true;
+	}
+
+	Vector4 CompactMesh::getColor(unsigned int index) const
+	{
+		return palette[vertices[index].paletteIndex];
+	}
+
+	Vector3 CompactMesh::getNormal(unsigned int index) const
+	{
+		return unpackNormal(vertices[index].normal);
+	}
+
+	const Vector3& CompactMesh::getOrigin() const
+	{
+		return origin;
+	}
+
+	const vector<Vector4>& CompactMesh::getPalette() const
+	{
+		return palette;
+	}
+
+	Vector3 CompactMesh::getPosition(unsigned int index) const
+	{
+		Vector3 position = origin;
+		for (unsigned int axis = 0; axis < 3; axis++)
+		{
+			position[axis] += vertices[index].position[axis] * scale[axis];
+		}
+
+		return position;
+	}
+
+	const Vector3& CompactMesh::getScale() const
+	{
+		return scale;
+	}
+
+	const vector<CompactMesh::Vertex>& CompactMesh::getVertices() const
+	{
+		return vertices;
+	}
+
+	uint16_t CompactMesh::packNormal(const Vector3& normal)
+	{
+		// Project onto the octahedron and fold the lower half over the upper half.
+		float length = fabs(normal.X()) + fabs(normal.Y()) + fabs(normal.Z());
+		if (length == 0.0f)
+		{
+			length = 1.0f;
+		}
+
+		float u = normal.X() / length;
+		float v = normal.Z() / length;
+
+		if (normal.Y() < 0.0f)
+		{
+			float foldedU = (1.0f - fabs(v)) * (u < 0.0f ? -1.0f : 1.0f);
+			float foldedV = (1.0f - fabs(u)) * (v < 0.0f ? -1.0f : 1.0f);
+			u = foldedU;
+			v = foldedV;
+		}
+
+		uint16_t packedU = static_cast<uint16_t>((u * 0.5f + 0.5f) * UINT8_MAX + 0.5f);
+		uint16_t packedV = static_cast<uint16_t>((v * 0.5f + 0.5f) * UINT8_MAX + 0.5f);
+
+		return packedU << 8 | packedV;
+	}
+
+	Vector3 CompactMesh::unpackNormal(uint16_t packedNormal)
+	{
+		float u = (packedNormal >> 8) / static_cast<float>(UINT8_MAX) * 2.0f - 1.0f;
+		float v = (packedNormal & UINT8_MAX) / static_cast<float>(UINT8_MAX) * 2.0f - 1.0f;
+
+		Vector3 normal(u, 1.0f - fabs(u) - fabs(v), v);
+
+		if (normal.Y() < 0.0f)
+		{
+			normal.X() = (1.0f - fabs(v)) * (u < 0.0f ? -1.0f : 1.0f);
+			normal.Z() = (1.0f - fabs(u)) * (v < 0.0f ? -1.0f : 1.0f);
+		}
+
+		normal.normalize();
+
+		return normal;
+	}
+}
@@ -0,0 +1,81 @@
+/*
+ * Copyright © 2014 Simple Entertainment Limited
+ *
+ * This file is part of The Island.
+ *
+ * The Island is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * The Island is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with The Island. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#ifndef COMPACTMESH_H_
+#define COMPACTMESH_H_
+
+#include <cstdint>
+
+#include <simplicity/API.h>
+
+namespace theisland
+{
+	/**
+	 * <p>
+	 * A compact copy of a mesh for hosts that render terrain themselves. Positions are quantized to 16 bits between
+	 * the mesh's origin and its extent, normals are octahedral packed into 16 bits and colors are an index into a
+	 * palette of up to 256 colors. Meshes with more colors than that cannot be compacted (see fitsPalette).
+	 * </p>
+	 */
+	class SIMPLE_API CompactMesh : public simplicity::Component
+	{
+		public:
+			struct Vertex
+			{
+				std::uint16_t position[3];
+
+				std::uint16_t normal;
+
+				std::uint8_t paletteIndex;
+
+				std::uint8_t padding;
+			};
+
+			CompactMesh(const simplicity::MeshData& meshData);
+
+			simplicity::Vector4 getColor(unsigned int index) const;
+
+			simplicity::Vector3 getNormal(unsigned int index) const;
+
+			const simplicity::Vector3& getOrigin() const;
+
+			const std::vector<simplicity::Vector4>& getPalette() const;
+
+			simplicity::Vector3 getPosition(unsigned int index) const;
+
+			const simplicity::Vector3& getScale() const;
+
+			const std::vector<Vertex>& getVertices() const;
+
+			// Whether the mesh has few enough colors to be compacted.
+			static bool fitsPalette(const simplicity::MeshData& meshData);
+
+			static std::uint16_t packNormal(const simplicity::Vector3& normal);
+
+			static simplicity::Vector3 unpackNormal(std::uint16_t packedNormal);
+
+		private:
+			simplicity::Vector3 origin;
+
+			std::vector<simplicity::Vector4> palette;
+
+			simplicity::Vector3 scale;
+
+			std::vector<Vertex> vertices;
+	};
+}
+
+#endif /* COMPACTMESH_H_ */
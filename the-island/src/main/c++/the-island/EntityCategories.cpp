@@ -0,0 +1,91 @@
+/*
+ * Copyright © 2014 Simple Entertainment Limited
+ *
+ * This file is part of The Island.
+ *
+ * The Island is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * The Island is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with The Island. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include "EntityCategories.h"
+
+using namespace simplicity;
+using namespace std;
+
+namespace theisland
+{
+	namespace EntityCategories
+	{
+		bool isCategorized(unsigned short category);
+
+		vector<Entity*> categorizedEntities[CATEGORY_COUNT];
+
+		const vector<Entity*> uncategorizedEntities;
+
+		void clearEntities()
+		{
+			for (vector<Entity*>& entities : categorizedEntities)
+			{
+				entities.clear();
+			}
+		}
+
+		const vector<Entity*>& getEntities(unsigned short category)
+		{
+			if (!isCategorized(category))
+			{
+				return uncategorizedEntities;
+			}
+
+			return categorizedEntities[category - GROUND];
+		}
+
+		void getEntities(unsigned int mask, vector<Entity*>& entities)
+		{
+			for (unsigned int index = 0; index < CATEGORY_COUNT; index++)
+			{
+				if (mask & (1u << index))
+				{
+					entities.insert(entities.end(), categorizedEntities[index].begin(),
+							categorizedEntities[index].end());
+				}
+			}
+		}
+
+		unsigned int getFoliageMask()
+		{
+			return getMask(FOLIAGE_BRANCH) | getMask(FOLIAGE_COLLISION) | getMask(FOLIAGE_GRASS) |
+					getMask(FOLIAGE_ROCK) | getMask(FOLIAGE_TREE);
+		}
+
+		unsigned int getMask(unsigned short category)
+		{
+			if (!isCategorized(category))
+			{
+				return 0;
+			}
+
+			return 1u << (category - GROUND);
+		}
+
+		bool isCategorized(unsigned short category)
+		{
+			return category >= GROUND && category < GROUND + CATEGORY_COUNT;
+		}
+
+		void registerEntity(Entity& entity)
+		{
+			if (isCategorized(entity.getCategory()))
+			{
+				categorizedEntities[entity.getCategory() - GROUND].push_back(&entity);
+			}
+		}
+	}
+}
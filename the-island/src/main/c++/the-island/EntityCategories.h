@@ -17,13 +17,44 @@
 #ifndef ENTITYCATEGORIES_H_
 #define ENTITYCATEGORIES_H_
 
+#include <vector>
+
 #include <simplicity/API.h>
 
 namespace theisland
 {
 	namespace EntityCategories
 	{
+		static unsigned short FOLIAGE_BRANCH = simplicity::Category::USER_ID_0 + 1;
+		// The invisible bodies the foliage collides with.
+		static unsigned short FOLIAGE_COLLISION = simplicity::Category::USER_ID_0 + 2;
+		static unsigned short FOLIAGE_GRASS = simplicity::Category::USER_ID_0 + 3;
+		static unsigned short FOLIAGE_ROCK = simplicity::Category::USER_ID_0 + 4;
+		static unsigned short FOLIAGE_TREE = simplicity::Category::USER_ID_0 + 5;
 		static unsigned short GROUND = simplicity::Category::USER_ID_0;
+		static unsigned short SKY = simplicity::Category::USER_ID_0 + 6;
+		static unsigned short WATER = simplicity::Category::USER_ID_0 + 7;
+
+		static const unsigned int CATEGORY_COUNT = 8;
+
+		// Removes every entity from the categories (e.g. when the island is removed from the scene).
+		SIMPLE_API void clearEntities();
+
+		// The entities of the island in a category.
+		SIMPLE_API const std::vector<simplicity::Entity*>& getEntities(unsigned short category);
+
+		// Collects the entities of the island in every category of the mask.
+		SIMPLE_API void getEntities(unsigned int mask, std::vector<simplicity::Entity*>& entities);
+
+		// The mask of every foliage category.
+		SIMPLE_API unsigned int getFoliageMask();
+
+		// The mask of a category, masks are combined with | to query several categories at once.
+		SIMPLE_API unsigned int getMask(unsigned short category);
+
+		// Adds an entity to its category so that it can be found without walking the scene. Entities in other
+		// categories are ignored. The entities added to the scene by the-island are added to their categories.
+		SIMPLE_API void registerEntity(simplicity::Entity& entity);
 	}
 }
 
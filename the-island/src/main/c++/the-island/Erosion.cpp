@@ -0,0 +1,402 @@
+/*
+ * Copyright © 2014 Simple Entertainment Limited
+ *
+ * This file is part of The Island.
+ *
+ * The Island is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * The Island is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with The Island. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <future>
+#include <random>
+#include <thread>
+#include <vector>
+
+#if (defined(__SSE2__) || defined(_M_X64)) && !defined(THE_ISLAND_SCALAR)
+#include <emmintrin.h>
+#endif
+
+#include "Erosion.h"
+
+using namespace std;
+
+static const float GRAVITY = 4.0f;
+static const float MIN_SLOPE = 0.01f;
+static const unsigned int TILE_SIZE = 64;
+
+// Droplets never leave their tile by more than this so that tiles with a tile between them never touch the same
+// cells.
+static const unsigned int HALO = TILE_SIZE / 2;
+
+namespace theisland
+{
+	namespace Erosion
+	{
+		void addSediment(float* heights, unsigned int edgeLength, unsigned int x, unsigned int z, float offsetX,
+				float offsetZ, float amount);
+		void erodeHydraulically(float* heights, unsigned int edgeLength, unsigned int minX, unsigned int minZ,
+				unsigned int maxX, unsigned int maxZ, const Settings& settings, unsigned int seed);
+		void erodeThermally(const float* source, float* target, unsigned int edgeLength, unsigned int minX,
+				unsigned int minZ, unsigned int maxX, unsigned int maxZ, const Settings& settings);
+		void forEachTile(const vector<unsigned int>& tiles, const function<void(unsigned int)>& erodeTile);
+		vector<unsigned int> getParityTiles(unsigned int tilesPerEdge, unsigned int parity);
+		float getThermalFlow(float height, float neighbourHeight, float talus);
+
+		void addSediment(float* heights, unsigned int edgeLength, unsigned int x, unsigned int z, float offsetX,
+				float offsetZ, float amount)
+		{
+			heights[x * edgeLength + z] += amount * (1.0f - offsetX) * (1.0f - offsetZ);
+			heights[x * edgeLength + z + 1] += amount * (1.0f - offsetX) * offsetZ;
+			heights[(x + 1) * edgeLength + z] += amount * offsetX * (1.0f - offsetZ);
+			heights[(x + 1) * edgeLength + z + 1] += amount * offsetX * offsetZ;
+		}
+
+		void erode(float* heights, unsigned int edgeLength, const Settings& settings)
+		{
+			if (edgeLength < 3)
+			{
+				return;
+			}
+
+			chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+			unsigned int tilesPerEdge = (edgeLength + TILE_SIZE - 1) / TILE_SIZE;
+			unsigned int tileCount = tilesPerEdge * tilesPerEdge;
+
+			vector<unsigned int> allTiles(tileCount);
+			for (unsigned int tile = 0; tile < tileCount; tile++)
+			{
+				allTiles[tile] = tile;
+			}
+
+			vector<vector<unsigned int>> parityTiles;
+			for (unsigned int parity = 0; parity < 4; parity++)
+			{
+				parityTiles.push_back(getParityTiles(tilesPerEdge, parity));
+			}
+
+			vector<float> thermalHeights(edgeLength * edgeLength);
+
+			for (unsigned int iteration = 0; iteration < settings.iterations; iteration++)
+			{
+				// Thermal erosion reads the halo of each tile from the heights of the last iteration so all the tiles
+				// can be eroded at once.
+				forEachTile(allTiles, [&](unsigned int tile)
+				{
+					unsigned int minX = (tile / tilesPerEdge) * TILE_SIZE;
+					unsigned int minZ = (tile % tilesPerEdge) * TILE_SIZE;
+					erodeThermally(heights, thermalHeights.data(), edgeLength, minX, minZ,
+							min(minX + TILE_SIZE, edgeLength), min(minZ + TILE_SIZE, edgeLength), settings);
+				});
+				copy(thermalHeights.begin(), thermalHeights.end(), heights);
+
+				// Droplets write to their halo too so only the tiles with a tile between them are eroded at once.
+				for (const vector<unsigned int>& tiles : parityTiles)
+				{
+					forEachTile(tiles, [&](unsigned int tile)
+					{
+						unsigned int minX = (tile / tilesPerEdge) * TILE_SIZE;
+						unsigned int minZ = (tile % tilesPerEdge) * TILE_SIZE;
+						erodeHydraulically(heights, edgeLength, minX, minZ, min(minX + TILE_SIZE, edgeLength),
+								min(minZ + TILE_SIZE, edgeLength), settings,
+								settings.seed + iteration * tileCount + tile);
+					});
+				}
+
+				chrono::duration<float> elapsed = chrono::steady_clock::now() - start;
+				if (settings.timeBudget > 0.0f && elapsed.count() >= settings.timeBudget)
+				{
+					break;
+				}
+			}
+		}
+
+		void erodeHydraulically(float* heights, unsigned int edgeLength, unsigned int minX, unsigned int minZ,
+				unsigned int maxX, unsigned int maxZ, const Settings& settings, unsigned int seed)
+		{
+			float haloMinX = minX > HALO ? minX - HALO : 0;
+			float haloMinZ = minZ > HALO ? minZ - HALO : 0;
+			float haloMaxX = min(maxX + HALO, edgeLength) - 1;
+			float haloMaxZ = min(maxZ + HALO, edgeLength) - 1;
+
+			// Droplets need a cell on each side of them to find the slope.
+			unsigned int startMaxX = min(maxX, edgeLength - 1);
+			unsigned int startMaxZ = min(maxZ, edgeLength - 1);
+			if (startMaxX <= minX || startMaxZ <= minZ)
+			{
+				return;
+			}
+
+			mt19937 random(seed);
+			uniform_real_distribution<float> distributionX(minX, startMaxX);
+			uniform_real_distribution<float> distributionZ(minZ, startMaxZ);
+
+			unsigned int dropletCount = settings.dropletDensity * (maxX - minX) * (maxZ - minZ) + 0.5f;
+			for (unsigned int droplet = 0; droplet < dropletCount; droplet++)
+			{
+				float positionX = distributionX(random);
+				float positionZ = distributionZ(random);
+				float directionX = 0.0f;
+				float directionZ = 0.0f;
+				float speed = 1.0f;
+				float water = 1.0f;
+				float sediment = 0.0f;
+
+				for (unsigned int step = 0; step < settings.dropletLifetime; step++)
+				{
+					unsigned int cellX = static_cast<unsigned int>(positionX);
+					unsigned int cellZ = static_cast<unsigned int>(positionZ);
+					float offsetX = positionX - cellX;
+					float offsetZ = positionZ - cellZ;
+
+					const float* cell = heights + cellX * edgeLength + cellZ;
+					float height00 = cell[0];
+					float height01 = cell[1];
+					float height10 = cell[edgeLength];
+					float height11 = cell[edgeLength + 1];
+
+					float height = height00 * (1.0f - offsetX) * (1.0f - offsetZ) +
+							height10 * offsetX * (1.0f - offsetZ) + height01 * (1.0f - offsetX) * offsetZ +
+							height11 * offsetX * offsetZ;
+					float gradientX = (height10 - height00) * (1.0f - offsetZ) + (height11 - height01) * offsetZ;
+					float gradientZ = (height01 - height00) * (1.0f - offsetX) + (height11 - height10) * offsetX;
+
+					directionX = directionX * settings.inertia - gradientX * (1.0f - settings.inertia);
+					directionZ = directionZ * settings.inertia - gradientZ * (1.0f - settings.inertia);
+					float directionLength = sqrt(directionX * directionX + directionZ * directionZ);
+					if (directionLength == 0.0f)
+					{
+						break;
+					}
+					directionX /= directionLength;
+					directionZ /= directionLength;
+
+					float nextPositionX = positionX + directionX;
+					float nextPositionZ = positionZ + directionZ;
+					if (nextPositionX < haloMinX || nextPositionX >= haloMaxX || nextPositionZ < haloMinZ ||
+							nextPositionZ >= haloMaxZ)
+					{
+						break;
+					}
+
+					unsigned int nextCellX = static_cast<unsigned int>(nextPositionX);
+					unsigned int nextCellZ = static_cast<unsigned int>(nextPositionZ);
+					float nextOffsetX = nextPositionX - nextCellX;
+					float nextOffsetZ = nextPositionZ - nextCellZ;
+					const float* nextCell = heights + nextCellX * edgeLength + nextCellZ;
+					float nextHeight = nextCell[0] * (1.0f - nextOffsetX) * (1.0f - nextOffsetZ) +
+							nextCell[edgeLength] * nextOffsetX * (1.0f - nextOffsetZ) +
+							nextCell[1] * (1.0f - nextOffsetX) * nextOffsetZ +
+							nextCell[edgeLength + 1] * nextOffsetX * nextOffsetZ;
+					float heightDifference = nextHeight - height;
+
+					float capacity = max(-heightDifference, MIN_SLOPE) * speed * water * settings.capacity;
+					if (heightDifference > 0.0f || sediment > capacity)
+					{
+						// Uphill the droplet fills the pit it is leaving, otherwise it drops what it cannot carry.
+						float deposit = heightDifference > 0.0f ? min(heightDifference, sediment) :
+								(sediment - capacity) * settings.depositionRate;
+						sediment -= deposit;
+						addSediment(heights, edgeLength, cellX, cellZ, offsetX, offsetZ, deposit);
+					}
+					else
+					{
+						// Never dig deeper than the droplet is going downhill.
+						float erosion = min((capacity - sediment) * settings.erosionRate, -heightDifference);
+						sediment += erosion;
+						addSediment(heights, edgeLength, cellX, cellZ, offsetX, offsetZ, -erosion);
+					}
+
+					speed = sqrt(max(0.0f, speed * speed - heightDifference * GRAVITY));
+					water *= 1.0f - settings.evaporationRate;
+					positionX = nextPositionX;
+					positionZ = nextPositionZ;
+				}
+			}
+		}
+
+		void erodeStep(float* heights, float* thermalHeights, const unsigned int* tileOrder, unsigned int edgeLength,
+				const Settings& settings, unsigned int step)
+		{
+			if (edgeLength < 3)
+			{
+				return;
+			}
+
+			unsigned int tilesPerEdge = (edgeLength + TILE_SIZE - 1) / TILE_SIZE;
+			unsigned int tileCount = tilesPerEdge * tilesPerEdge;
+			unsigned int iteration = step / (tileCount * 2);
+			unsigned int iterationStep = step % (tileCount * 2);
+
+			// Each iteration erodes every tile thermally and then every tile hydraulically in the order erode does.
+			if (iterationStep < tileCount)
+			{
+				unsigned int minX = (iterationStep / tilesPerEdge) * TILE_SIZE;
+				unsigned int minZ = (iterationStep % tilesPerEdge) * TILE_SIZE;
+				erodeThermally(heights, thermalHeights, edgeLength, minX, minZ, min(minX + TILE_SIZE, edgeLength),
+						min(minZ + TILE_SIZE, edgeLength), settings);
+
+				if (iterationStep == tileCount - 1)
+				{
+					copy(thermalHeights, thermalHeights + edgeLength * edgeLength, heights);
+				}
+
+				return;
+			}
+
+			unsigned int tile = tileOrder[iterationStep - tileCount];
+			unsigned int minX = (tile / tilesPerEdge) * TILE_SIZE;
+			unsigned int minZ = (tile % tilesPerEdge) * TILE_SIZE;
+			erodeHydraulically(heights, edgeLength, minX, minZ, min(minX + TILE_SIZE, edgeLength),
+					min(minZ + TILE_SIZE, edgeLength), settings, settings.seed + iteration * tileCount + tile);
+		}
+
+		void erodeThermally(const float* source, float* target, unsigned int edgeLength, unsigned int minX,
+				unsigned int minZ, unsigned int maxX, unsigned int maxZ, const Settings& settings)
+		{
+			for (unsigned int x = minX; x < maxX; x++)
+			{
+				const float* row = source + x * edgeLength;
+				const float* previousRow = row - edgeLength;
+				const float* nextRow = row + edgeLength;
+				float* targetRow = target + x * edgeLength;
+
+				// The edges of the height map are left as they are.
+				if (x == 0 || x == edgeLength - 1)
+				{
+					copy(row + minZ, row + maxZ, targetRow + minZ);
+					continue;
+				}
+
+				unsigned int z = minZ;
+				if (z == 0)
+				{
+					targetRow[z] = row[z];
+					z++;
+				}
+				unsigned int endZ = min(maxZ, edgeLength - 1);
+
+#if (defined(__SSE2__) || defined(_M_X64)) && !defined(THE_ISLAND_SCALAR)
+				__m128 talus = _mm_set1_ps(settings.talus);
+				__m128 rate = _mm_set1_ps(settings.thermalRate);
+				__m128 zero = _mm_setzero_ps();
+
+				for (; z + 4 <= endZ; z += 4)
+				{
+					__m128 height = _mm_loadu_ps(row + z);
+					__m128 neighbours[4] =
+					{
+						_mm_loadu_ps(previousRow + z),
+						_mm_loadu_ps(nextRow + z),
+						_mm_loadu_ps(row + z - 1),
+						_mm_loadu_ps(row + z + 1)
+					};
+
+					__m128 flow = zero;
+					for (__m128 neighbour : neighbours)
+					{
+						__m128 inflow = _mm_max_ps(zero, _mm_sub_ps(_mm_sub_ps(neighbour, height), talus));
+						__m128 outflow = _mm_max_ps(zero, _mm_sub_ps(_mm_sub_ps(height, neighbour), talus));
+						flow = _mm_add_ps(flow, _mm_sub_ps(inflow, outflow));
+					}
+
+					_mm_storeu_ps(targetRow + z, _mm_add_ps(height, _mm_mul_ps(rate, flow)));
+				}
+#endif
+
+				for (; z < endZ; z++)
+				{
+					float height = row[z];
+					float flow = 0.0f;
+					flow += getThermalFlow(height, previousRow[z], settings.talus);
+					flow += getThermalFlow(height, nextRow[z], settings.talus);
+					flow += getThermalFlow(height, row[z - 1], settings.talus);
+					flow += getThermalFlow(height, row[z + 1], settings.talus);
+
+					targetRow[z] = height + settings.thermalRate * flow;
+				}
+
+				if (z < maxZ)
+				{
+					targetRow[z] = row[z];
+				}
+			}
+		}
+
+		void forEachTile(const vector<unsigned int>& tiles, const function<void(unsigned int)>& erodeTile)
+		{
+			unsigned int workerCount = min(max(1u, thread::hardware_concurrency()),
+					static_cast<unsigned int>(tiles.size()));
+
+			auto erodeTiles = [&](unsigned int worker)
+			{
+				for (unsigned int index = worker; index < tiles.size(); index += workerCount)
+				{
+					erodeTile(tiles[index]);
+				}
+			};
+
+			vector<future<void>> workers;
+			for (unsigned int worker = 1; worker < workerCount; worker++)
+			{
+				workers.push_back(async(launch::async, erodeTiles, worker));
+			}
+			erodeTiles(0);
+
+			for (future<void>& worker : workers)
+			{
+				worker.get();
+			}
+		}
+
+		unsigned int getIterationStepCount(unsigned int edgeLength)
+		{
+			unsigned int tilesPerEdge = (edgeLength + TILE_SIZE - 1) / TILE_SIZE;
+
+			return tilesPerEdge * tilesPerEdge * 2;
+		}
+
+		vector<unsigned int> getParityTiles(unsigned int tilesPerEdge, unsigned int parity)
+		{
+			// The tiles with a tile between them.
+			vector<unsigned int> tiles;
+			for (unsigned int tile = 0; tile < tilesPerEdge * tilesPerEdge; tile++)
+			{
+				unsigned int tileX = tile / tilesPerEdge;
+				unsigned int tileZ = tile % tilesPerEdge;
+				if ((tileX % 2) * 2 + tileZ % 2 == parity)
+				{
+					tiles.push_back(tile);
+				}
+			}
+
+			return tiles;
+		}
+
+		void getTileOrder(unsigned int edgeLength, unsigned int* tiles)
+		{
+			unsigned int tilesPerEdge = (edgeLength + TILE_SIZE - 1) / TILE_SIZE;
+			for (unsigned int parity = 0; parity < 4; parity++)
+			{
+				vector<unsigned int> parityTiles = getParityTiles(tilesPerEdge, parity);
+				tiles = copy(parityTiles.begin(), parityTiles.end(), tiles);
+			}
+		}
+
+		float getThermalFlow(float height, float neighbourHeight, float talus)
+		{
+			// Material slides in from higher neighbours and out to lower ones.
+			return max(0.0f, neighbourHeight - height - talus) - max(0.0f, height - neighbourHeight - talus);
+		}
+	}
+}
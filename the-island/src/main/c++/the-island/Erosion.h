@@ -0,0 +1,88 @@
+/*
+ * Copyright © 2014 Simple Entertainment Limited
+ *
+ * This file is part of The Island.
+ *
+ * The Island is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * The Island is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with The Island. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#ifndef EROSION_H_
+#define EROSION_H_
+
+#include <simplicity/API.h>
+
+namespace theisland
+{
+	/**
+	 * <p>
+	 * Erodes a height map with thermal erosion (material sliding down slopes steeper than the talus) and hydraulic
+	 * erosion (droplets carrying sediment downhill). The height map is split into tiles that are eroded in parallel,
+	 * each reading a halo of its neighbours.
+	 * </p>
+	 */
+	namespace Erosion
+	{
+		struct SIMPLE_API Settings
+		{
+			// How much the sediment a droplet can carry grows with its speed, water and the slope beneath it.
+			float capacity = 4.0f;
+
+			// How much of the sediment over its capacity a droplet drops each step.
+			float depositionRate = 0.3f;
+
+			// The droplets released per height map cell each iteration.
+			float dropletDensity = 0.05f;
+
+			// The most steps a droplet takes.
+			unsigned int dropletLifetime = 24;
+
+			// How much of the sediment under its capacity a droplet picks up each step.
+			float erosionRate = 0.3f;
+
+			// How much of its water a droplet loses each step.
+			float evaporationRate = 0.02f;
+
+			// How much a droplet keeps going the way it was going instead of straight downhill.
+			float inertia = 0.05f;
+
+			unsigned int iterations = 10;
+
+			unsigned int seed = 0;
+
+			// The steepest height difference between neighbouring cells that thermal erosion leaves alone.
+			float talus = 0.5f;
+
+			// How much of the height difference over the talus slides down each iteration (at most 0.25).
+			float thermalRate = 0.2f;
+
+			// The most seconds erosion may take (0 for no limit). Iterations are never cut short so the result only
+			// depends on how many of them fit in the budget.
+			float timeBudget = 0.0f;
+		};
+
+		// Erodes the height map (row by row) in place.
+		SIMPLE_API void erode(float* heights, unsigned int edgeLength, const Settings& settings);
+
+		// Erodes one tile of the height map with one kind of erosion on this thread, for hosts that erode a step at a
+		// time. Taking the steps of every iteration in order erodes the height map the same way as erode does. The
+		// thermal heights (as many as the heights) and the tile order (see getTileOrder) are kept between the steps.
+		SIMPLE_API void erodeStep(float* heights, float* thermalHeights, const unsigned int* tileOrder,
+				unsigned int edgeLength, const Settings& settings, unsigned int step);
+
+		// The number of steps in each iteration of eroding a height map a step at a time.
+		SIMPLE_API unsigned int getIterationStepCount(unsigned int edgeLength);
+
+		// The tiles in the order each iteration erodes them hydraulically (as many as half the steps of an iteration).
+		SIMPLE_API void getTileOrder(unsigned int edgeLength, unsigned int* tiles);
+	}
+}
+
+#endif /* EROSION_H_ */
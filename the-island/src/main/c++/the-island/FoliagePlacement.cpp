@@ -0,0 +1,238 @@
+/*
+ * Copyright © 2014 Simple Entertainment Limited
+ *
+ * This file is part of The Island.
+ *
+ * The Island is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * The Island is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with The Island. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <future>
+#include <random>
+#include <thread>
+
+#include "Biomes.h"
+#include "FoliagePlacement.h"
+
+using namespace simplicity;
+using namespace std;
+
+static const unsigned int MAX_ATTEMPTS_PER_INSTANCE = 30;
+
+namespace theisland
+{
+	namespace FoliagePlacement
+	{
+		void addParityChunks(unsigned int chunksPerEdge, unsigned int parity, ArenaVector<unsigned int>& chunks);
+		void placeInChunk(const ArenaVector<Candidate>& candidates, const Settings& settings, unsigned int seed,
+				SpatialHash& hash, ArenaVector<Vector3>& rockPositions, ArenaVector<Vector3>& treePositions);
+		void placeInstances(const ArenaVector<Candidate>& candidates, const ArenaVector<float>& areas, bool trees,
+				float radius, float density, mt19937& random, SpatialHash& hash, ArenaVector<Vector3>& positions);
+
+		void addParityChunks(unsigned int chunksPerEdge, unsigned int parity, ArenaVector<unsigned int>& chunks)
+		{
+			for (unsigned int chunk = 0; chunk < chunksPerEdge * chunksPerEdge; chunk++)
+			{
+				unsigned int chunkX = chunk / chunksPerEdge;
+				unsigned int chunkZ = chunk % chunksPerEdge;
+				if ((chunkX % 2) * 2 + chunkZ % 2 == parity)
+				{
+					chunks.push_back(chunk);
+				}
+			}
+		}
+
+		unique_ptr<SpatialHash> createHash(unsigned int chunksPerEdge, float chunkWidth, float minX, float minZ,
+				const Settings& settings)
+		{
+			return unique_ptr<SpatialHash>(new SpatialHash(minX, minZ, chunkWidth * chunksPerEdge,
+					max(settings.rockSpacing, settings.treeSpacing)));
+		}
+
+		void getChunkOrder(unsigned int chunksPerEdge, ArenaVector<unsigned int>& chunks)
+		{
+			chunks.clear();
+			chunks.reserve(chunksPerEdge * chunksPerEdge);
+			for (unsigned int parity = 0; parity < 4; parity++)
+			{
+				addParityChunks(chunksPerEdge, parity, chunks);
+			}
+		}
+
+		void place(const ArenaVector<ArenaVector<Candidate>>& chunkCandidates, unsigned int chunksPerEdge,
+				float chunkWidth, float minX, float minZ, const Settings& settings, ArenaVector<Vector3>& rockPositions,
+				ArenaVector<Vector3>& treePositions)
+		{
+			unsigned int chunkCount = chunkCandidates.size();
+			unique_ptr<SpatialHash> hash = createHash(chunksPerEdge, chunkWidth, minX, minZ, settings);
+
+			// Chunks only read and write the cells of the hash within a cell of themselves. Chunks with a chunk between
+			// them (the same parity on both axes) are far enough apart to be placed in parallel if they are at least
+			// three cells wide.
+			bool parallel = chunkWidth >= hash->getCellSize() * 3.0f;
+			unsigned int workerCount = parallel ? max(1u, thread::hardware_concurrency()) : 1;
+
+			// Arenas cannot be shared between threads so each worker places its chunks in an arena of its own.
+			vector<Arena> arenas(workerCount);
+
+			ArenaVector<unsigned int> order(rockPositions.get_allocator());
+			order.reserve(chunkCount);
+			ArenaVector<ArenaVector<Vector3>> chunkRockPositions(rockPositions.get_allocator());
+			chunkRockPositions.reserve(chunkCount);
+			ArenaVector<ArenaVector<Vector3>> chunkTreePositions(treePositions.get_allocator());
+			chunkTreePositions.reserve(chunkCount);
+
+			for (unsigned int parity = 0; parity < 4; parity++)
+			{
+				unsigned int begin = order.size();
+				addParityChunks(chunksPerEdge, parity, order);
+
+				for (unsigned int index = begin; index < order.size(); index++)
+				{
+					Arena& arena = arenas[(index - begin) % workerCount];
+					chunkRockPositions.emplace_back(ArenaAllocator<Vector3>(arena));
+					chunkTreePositions.emplace_back(ArenaAllocator<Vector3>(arena));
+				}
+
+				auto placeChunks = [&](unsigned int worker)
+				{
+					for (unsigned int index = begin + worker; index < order.size(); index += workerCount)
+					{
+						unsigned int chunk = order[index];
+						placeInChunk(chunkCandidates[chunk], settings, settings.seed + chunk, *hash,
+								chunkRockPositions[index], chunkTreePositions[index]);
+					}
+				};
+
+				vector<future<void>> workers;
+				for (unsigned int worker = 1; worker < workerCount; worker++)
+				{
+					workers.push_back(async(launch::async, placeChunks, worker));
+				}
+				placeChunks(0);
+
+				for (future<void>& worker : workers)
+				{
+					worker.get();
+				}
+			}
+
+			// In the order the chunks are placed a step at a time.
+			for (unsigned int index = 0; index < chunkCount; index++)
+			{
+				rockPositions.insert(rockPositions.end(), chunkRockPositions[index].begin(),
+						chunkRockPositions[index].end());
+				treePositions.insert(treePositions.end(), chunkTreePositions[index].begin(),
+						chunkTreePositions[index].end());
+			}
+		}
+
+		void placeChunk(const ArenaVector<ArenaVector<Candidate>>& chunkCandidates, unsigned int chunk,
+				const Settings& settings, SpatialHash& hash, ArenaVector<Vector3>& rockPositions,
+				ArenaVector<Vector3>& treePositions)
+		{
+			placeInChunk(chunkCandidates[chunk], settings, settings.seed + chunk, hash, rockPositions, treePositions);
+		}
+
+		void placeInChunk(const ArenaVector<Candidate>& candidates, const Settings& settings, unsigned int seed,
+				SpatialHash& hash, ArenaVector<Vector3>& rockPositions, ArenaVector<Vector3>& treePositions)
+		{
+			if (candidates.empty())
+			{
+				return;
+			}
+
+			mt19937 random(seed);
+
+			ArenaVector<float> areas(rockPositions.get_allocator());
+			areas.reserve(candidates.size());
+			for (const Candidate& candidate : candidates)
+			{
+				Vector3 normal = crossProduct(candidate.vertices[1] - candidate.vertices[0],
+						candidate.vertices[2] - candidate.vertices[0]);
+				areas.push_back(normal.getMagnitude() / 2.0f);
+			}
+
+			// The trees need the most room so they go first.
+			placeInstances(candidates, areas, true, settings.treeSpacing / 2.0f, settings.density, random, hash,
+					treePositions);
+			placeInstances(candidates, areas, false, settings.rockSpacing / 2.0f, settings.density, random, hash,
+					rockPositions);
+		}
+
+		void placeInstances(const ArenaVector<Candidate>& candidates, const ArenaVector<float>& areas, bool trees,
+				float radius, float density, mt19937& random, SpatialHash& hash, ArenaVector<Vector3>& positions)
+		{
+			// Candidates are picked in proportion to how much foliage they should have.
+			ArenaVector<float> weights(candidates.size(), 0.0f, positions.get_allocator());
+			float totalWeight = 0.0f;
+			for (unsigned int index = 0; index < candidates.size(); index++)
+			{
+				unsigned char biome = candidates[index].biome;
+				totalWeight += areas[index] * (trees ? Biomes::getTreeDensity(biome) : Biomes::getRockDensity(biome));
+				weights[index] = totalWeight;
+			}
+
+			if (totalWeight <= 0.0f)
+			{
+				return;
+			}
+
+			uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+			float expectedCount = totalWeight * density;
+			unsigned int count = static_cast<unsigned int>(expectedCount);
+			if (unit(random) < expectedCount - count)
+			{
+				count++;
+			}
+
+			unsigned int placedCount = 0;
+			for (unsigned int attempt = 0; attempt < count * MAX_ATTEMPTS_PER_INSTANCE && placedCount < count;
+					attempt++)
+			{
+				unsigned int index = lower_bound(weights.begin(), weights.end(), unit(random) * totalWeight) -
+						weights.begin();
+				const Candidate& candidate = candidates[min(index, static_cast<unsigned int>(candidates.size() - 1))];
+
+				float u = unit(random);
+				float v = unit(random);
+				if (u + v > 1.0f)
+				{
+					u = 1.0f - u;
+					v = 1.0f - v;
+				}
+
+				Vector3 position = candidate.vertices[0] + (candidate.vertices[1] - candidate.vertices[0]) * u +
+						(candidate.vertices[2] - candidate.vertices[0]) * v;
+
+				// Rocks stay out of the water and trees stay off the beach.
+				if ((!trees && candidate.maxHeight <= 0.0f) || (trees && position.Y() <= 0.8f))
+				{
+					continue;
+				}
+
+				if (!hash.isFree(position, radius))
+				{
+					continue;
+				}
+
+				hash.add(position, radius);
+
+				if (trees)
+				{
+					position.Y() -= 0.1f;
+				}
+				positions.push_back(position);
+				placedCount++;
+			}
+		}
+	}
+}
@@ -0,0 +1,78 @@
+/*
+ * Copyright © 2014 Simple Entertainment Limited
+ *
+ * This file is part of The Island.
+ *
+ * The Island is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * The Island is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with The Island. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#ifndef FOLIAGEPLACEMENT_H_
+#define FOLIAGEPLACEMENT_H_
+
+#include <memory>
+
+#include <simplicity/API.h>
+
+#include "Arena.h"
+#include "SpatialHash.h"
+
+namespace theisland
+{
+	namespace FoliagePlacement
+	{
+		// A triangle foliage could be placed on.
+		struct Candidate
+		{
+			unsigned char biome;
+
+			float maxHeight;
+
+			simplicity::Vector3 vertices[3];
+		};
+
+		struct Settings
+		{
+			// Scales the foliage density of every biome.
+			float density = 1.0f;
+
+			// The minimum distance between rocks. Rocks and trees are kept apart by the average of the two spacings.
+			float rockSpacing = 2.0f;
+
+			unsigned int seed = 0;
+
+			// The minimum distance between trees.
+			float treeSpacing = 3.0f;
+		};
+
+		// The hash that keeps the foliage of all the chunks apart, for hosts that place a chunk at a time.
+		std::unique_ptr<SpatialHash> createHash(unsigned int chunksPerEdge, float chunkWidth, float minX, float minZ,
+				const Settings& settings);
+
+		// The chunks in the order they are placed a step at a time (chunks with a chunk between them are placed
+		// together).
+		void getChunkOrder(unsigned int chunksPerEdge, ArenaVector<unsigned int>& chunks);
+
+		// Places rocks and trees on the candidate triangles of each chunk (blue noise, no two closer than their
+		// spacing) with the densities of the candidates' biomes. Chunks that are far enough apart are placed in
+		// parallel, the results only depend on the seed.
+		void place(const ArenaVector<ArenaVector<Candidate>>& chunkCandidates, unsigned int chunksPerEdge,
+				float chunkWidth, float minX, float minZ, const Settings& settings,
+				ArenaVector<simplicity::Vector3>& rockPositions, ArenaVector<simplicity::Vector3>& treePositions);
+
+		// Places the rocks and trees of one chunk on this thread. Placing the chunk of every step in order places the
+		// same foliage as place does.
+		void placeChunk(const ArenaVector<ArenaVector<Candidate>>& chunkCandidates, unsigned int chunk,
+				const Settings& settings, SpatialHash& hash, ArenaVector<simplicity::Vector3>& rockPositions,
+				ArenaVector<simplicity::Vector3>& treePositions);
+	}
+}
+
+#endif /* FOLIAGEPLACEMENT_H_ */
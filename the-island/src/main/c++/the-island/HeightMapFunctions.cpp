@@ -0,0 +1,66 @@
+/*
+ * Copyright © 2014 Simple Entertainment Limited
+ *
+ * This file is part of The Island.
+ *
+ * The Island is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * The Island is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with The Island. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include "HeightMapFunctions.h"
+
+using namespace simplicity;
+using namespace std;
+
+namespace theisland
+{
+	namespace HeightMapFunctions
+	{
+		void getCoordinates(const vector<vector<float>>& heightMap, const Vector3& position, unsigned int& x,
+				unsigned int& z)
+		{
+			float halfEdgeLength = static_cast<float>(heightMap.size() / 2);
+			float maxCoordinate = static_cast<float>(heightMap.size() - 1);
+
+			x = static_cast<unsigned int>(min(max(position.X() + halfEdgeLength + 0.5f, 0.0f), maxCoordinate));
+			z = static_cast<unsigned int>(min(max(position.Z() + halfEdgeLength + 0.5f, 0.0f), maxCoordinate));
+		}
+
+		void getCoordinates(unsigned int edgeLength, const Vector3& position, float& x, float& z)
+		{
+			float halfEdgeLength = static_cast<float>(edgeLength / 2);
+
+			x = position.X() + halfEdgeLength;
+			z = position.Z() + halfEdgeLength;
+		}
+
+		Vector3 getNormal(const vector<vector<float>>& heightMap, unsigned int x, unsigned int z)
+		{
+			unsigned int maxCoordinate = heightMap.size() - 1;
+			unsigned int minX = x > 0 ? x - 1 : x;
+			unsigned int maxX = x < maxCoordinate ? x + 1 : x;
+			unsigned int minZ = z > 0 ? z - 1 : z;
+			unsigned int maxZ = z < maxCoordinate ? z + 1 : z;
+
+			Vector3 normal(-(heightMap[maxX][z] - heightMap[minX][z]) / (maxX - minX), 1.0f,
+					-(heightMap[x][maxZ] - heightMap[x][minZ]) / (maxZ - minZ));
+			normal.normalize();
+
+			return normal;
+		}
+
+		Vector3 getPosition(const vector<vector<float>>& heightMap, unsigned int x, unsigned int z)
+		{
+			float halfEdgeLength = static_cast<float>(heightMap.size() / 2);
+
+			return Vector3(x - halfEdgeLength, heightMap[x][z], z - halfEdgeLength);
+		}
+	}
+}
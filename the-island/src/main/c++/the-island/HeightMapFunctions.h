@@ -0,0 +1,44 @@
+/*
+ * Copyright © 2014 Simple Entertainment Limited
+ *
+ * This file is part of The Island.
+ *
+ * The Island is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * The Island is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with The Island. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#ifndef HEIGHTMAPFUNCTIONS_H_
+#define HEIGHTMAPFUNCTIONS_H_
+
+#include <simplicity/API.h>
+
+namespace theisland
+{
+	namespace HeightMapFunctions
+	{
+		// Converts a position to the nearest height map coordinate (clamped to the height map).
+		void getCoordinates(const std::vector<std::vector<float>>& heightMap, const simplicity::Vector3& position,
+				unsigned int& x, unsigned int& z);
+
+		// Converts a position to the fractional height map coordinate beneath it (not clamped).
+		void getCoordinates(unsigned int edgeLength, const simplicity::Vector3& position, float& x, float& z);
+
+		// Calculates the normal of the surface described by the height map at a height map coordinate.
+		simplicity::Vector3 getNormal(const std::vector<std::vector<float>>& heightMap, unsigned int x,
+				unsigned int z);
+
+		// Converts a height map coordinate to the position the height map mesh gives it (the island is centered on
+		// the origin).
+		simplicity::Vector3 getPosition(const std::vector<std::vector<float>>& heightMap, unsigned int x,
+				unsigned int z);
+	}
+}
+
+#endif /* HEIGHTMAPFUNCTIONS_H_ */
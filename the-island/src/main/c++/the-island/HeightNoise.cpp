@@ -0,0 +1,263 @@
+/*
+ * Copyright © 2014 Simple Entertainment Limited
+ *
+ * This file is part of The Island.
+ *
+ * The Island is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * The Island is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with The Island. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <future>
+#include <thread>
+
+#if (defined(__SSE2__) || defined(_M_X64)) && !defined(THE_ISLAND_SCALAR)
+#include <emmintrin.h>
+#endif
+
+#include "HeightNoise.h"
+
+using namespace simplicity;
+using namespace std;
+
+static const unsigned int HASH_MULTIPLIER_X = 0x27d4eb2d;
+static const unsigned int HASH_MULTIPLIER_Z = 0x165667b1;
+static const unsigned int HASH_MIXER = 0x2c1b3c6d;
+static const unsigned int OCTAVE_SEED_STEP = 0x9e3779b9;
+static const unsigned int TILE_SIZE = 64;
+
+namespace theisland
+{
+	namespace HeightNoise
+	{
+		float getLatticeValue(unsigned int hashX, unsigned int latticeZ, unsigned int seed);
+		float getNoiseScale(const Settings& settings);
+		float getProfileHeight(const vector<float>& profile, unsigned int edgeLength, unsigned int x, unsigned int z);
+
+#if (defined(__SSE2__) || defined(_M_X64)) && !defined(THE_ISLAND_SCALAR)
+		__m128 getLatticeValues(__m128i hashX, __m128i latticeZ, __m128i seed);
+		__m128i multiply(__m128i a, __m128i b);
+#endif
+
+		void generate(const vector<float>& profile, unsigned int edgeLength, const Settings& settings, float* heights)
+		{
+			unsigned int tilesPerEdge = (edgeLength + TILE_SIZE - 1) / TILE_SIZE;
+			unsigned int tileCount = tilesPerEdge * tilesPerEdge;
+			unsigned int workerCount = min(max(1u, thread::hardware_concurrency()), tileCount);
+
+			auto generateTiles = [&](unsigned int worker)
+			{
+				for (unsigned int tile = worker; tile < tileCount; tile += workerCount)
+				{
+					unsigned int minX = (tile / tilesPerEdge) * TILE_SIZE;
+					unsigned int minZ = (tile % tilesPerEdge) * TILE_SIZE;
+					generateTile(profile, edgeLength, minX, minZ, min(minX + TILE_SIZE, edgeLength),
+							min(minZ + TILE_SIZE, edgeLength), settings, heights + minX * edgeLength + minZ,
+							edgeLength);
+				}
+			};
+
+			vector<future<void>> workers;
+			for (unsigned int worker = 1; worker < workerCount; worker++)
+			{
+				workers.push_back(async(launch::async, generateTiles, worker));
+			}
+			generateTiles(0);
+
+			for (future<void>& worker : workers)
+			{
+				worker.get();
+			}
+		}
+
+		void generateTile(const vector<float>& profile, unsigned int edgeLength, unsigned int minX,
+				unsigned int minZ, unsigned int maxX, unsigned int maxZ, const Settings& settings, float* heights,
+				unsigned int rowStride)
+		{
+			float noiseScale = getNoiseScale(settings);
+
+			for (unsigned int x = minX; x < maxX; x++)
+			{
+				float* rowHeights = heights + (x - minX) * rowStride - minZ;
+				for (unsigned int z = minZ; z < maxZ; z++)
+				{
+					rowHeights[z] = getProfileHeight(profile, edgeLength, x, z);
+				}
+
+				// The lattice coordinates are the same along the whole row so only the Z coordinates vary per lane.
+				unsigned int z = minZ;
+
+#if (defined(__SSE2__) || defined(_M_X64)) && !defined(THE_ISLAND_SCALAR)
+				for (; z + 4 <= maxZ; z += 4)
+				{
+					__m128 sum = _mm_setzero_ps();
+					float amplitude = 1.0f;
+					float frequency = settings.frequency;
+					unsigned int seed = settings.seed;
+					__m128 lanesZ = _mm_cvtepi32_ps(_mm_setr_epi32(z, z + 1, z + 2, z + 3));
+
+					for (unsigned int octave = 0; octave < settings.octaves; octave++)
+					{
+						float pointX = x * frequency;
+						unsigned int latticeX = static_cast<unsigned int>(pointX);
+						float tX = pointX - latticeX;
+						__m128 smoothX = _mm_set1_ps(tX * tX * (3.0f - 2.0f * tX));
+
+						__m128 pointZ = _mm_mul_ps(lanesZ, _mm_set1_ps(frequency));
+						__m128i latticeZ = _mm_cvttps_epi32(pointZ);
+						__m128 tZ = _mm_sub_ps(pointZ, _mm_cvtepi32_ps(latticeZ));
+						__m128 smoothZ = _mm_mul_ps(_mm_mul_ps(tZ, tZ),
+								_mm_sub_ps(_mm_set1_ps(3.0f), _mm_mul_ps(_mm_set1_ps(2.0f), tZ)));
+
+						__m128i hashX0 = _mm_set1_epi32(latticeX * HASH_MULTIPLIER_X);
+						__m128i hashX1 = _mm_set1_epi32((latticeX + 1) * HASH_MULTIPLIER_X);
+						__m128i latticeZ1 = _mm_add_epi32(latticeZ, _mm_set1_epi32(1));
+						__m128i seeds = _mm_set1_epi32(seed);
+
+						__m128 value00 = getLatticeValues(hashX0, latticeZ, seeds);
+						__m128 value01 = getLatticeValues(hashX0, latticeZ1, seeds);
+						__m128 value10 = getLatticeValues(hashX1, latticeZ, seeds);
+						__m128 value11 = getLatticeValues(hashX1, latticeZ1, seeds);
+
+						__m128 value0 = _mm_add_ps(value00, _mm_mul_ps(_mm_sub_ps(value01, value00), smoothZ));
+						__m128 value1 = _mm_add_ps(value10, _mm_mul_ps(_mm_sub_ps(value11, value10), smoothZ));
+						__m128 value = _mm_add_ps(value0, _mm_mul_ps(_mm_sub_ps(value1, value0), smoothX));
+
+						sum = _mm_add_ps(sum, _mm_mul_ps(value, _mm_set1_ps(amplitude)));
+
+						amplitude *= settings.persistence;
+						frequency *= settings.lacunarity;
+						seed += OCTAVE_SEED_STEP;
+					}
+
+					__m128 profileHeights = _mm_loadu_ps(rowHeights + z);
+					_mm_storeu_ps(rowHeights + z, _mm_add_ps(profileHeights, _mm_mul_ps(sum, _mm_set1_ps(noiseScale))));
+				}
+#endif
+
+				for (; z < maxZ; z++)
+				{
+					rowHeights[z] = getHeight(profile, edgeLength, x, z, settings);
+				}
+			}
+		}
+
+		float getHeight(const vector<float>& profile, unsigned int edgeLength, unsigned int x, unsigned int z,
+				const Settings& settings)
+		{
+			float sum = 0.0f;
+			float amplitude = 1.0f;
+			float frequency = settings.frequency;
+			unsigned int seed = settings.seed;
+
+			for (unsigned int octave = 0; octave < settings.octaves; octave++)
+			{
+				float pointX = x * frequency;
+				unsigned int latticeX = static_cast<unsigned int>(pointX);
+				float tX = pointX - latticeX;
+				float smoothX = tX * tX * (3.0f - 2.0f * tX);
+
+				float pointZ = static_cast<float>(z) * frequency;
+				unsigned int latticeZ = static_cast<unsigned int>(pointZ);
+				float tZ = pointZ - latticeZ;
+				float smoothZ = tZ * tZ * (3.0f - 2.0f * tZ);
+
+				unsigned int hashX0 = latticeX * HASH_MULTIPLIER_X;
+				unsigned int hashX1 = (latticeX + 1) * HASH_MULTIPLIER_X;
+
+				float value00 = getLatticeValue(hashX0, latticeZ, seed);
+				float value01 = getLatticeValue(hashX0, latticeZ + 1, seed);
+				float value10 = getLatticeValue(hashX1, latticeZ, seed);
+				float value11 = getLatticeValue(hashX1, latticeZ + 1, seed);
+
+				float value0 = value00 + (value01 - value00) * smoothZ;
+				float value1 = value10 + (value11 - value10) * smoothZ;
+				float value = value0 + (value1 - value0) * smoothX;
+
+				sum += value * amplitude;
+
+				amplitude *= settings.persistence;
+				frequency *= settings.lacunarity;
+				seed += OCTAVE_SEED_STEP;
+			}
+
+			return getProfileHeight(profile, edgeLength, x, z) + sum * getNoiseScale(settings);
+		}
+
+		float getLatticeValue(unsigned int hashX, unsigned int latticeZ, unsigned int seed)
+		{
+			unsigned int hash = hashX ^ (latticeZ * HASH_MULTIPLIER_Z) ^ seed;
+			hash ^= hash >> 15;
+			hash *= HASH_MIXER;
+			hash ^= hash >> 12;
+
+			return static_cast<float>(hash & 0xffffff) * (2.0f / 0xffffff) - 1.0f;
+		}
+
+#if (defined(__SSE2__) || defined(_M_X64)) && !defined(THE_ISLAND_SCALAR)
+		__m128 getLatticeValues(__m128i hashX, __m128i latticeZ, __m128i seed)
+		{
+			__m128i hash = _mm_xor_si128(_mm_xor_si128(hashX, multiply(latticeZ, _mm_set1_epi32(HASH_MULTIPLIER_Z))),
+					seed);
+			hash = _mm_xor_si128(hash, _mm_srli_epi32(hash, 15));
+			hash = multiply(hash, _mm_set1_epi32(HASH_MIXER));
+			hash = _mm_xor_si128(hash, _mm_srli_epi32(hash, 12));
+
+			__m128 value = _mm_cvtepi32_ps(_mm_and_si128(hash, _mm_set1_epi32(0xffffff)));
+			return _mm_sub_ps(_mm_mul_ps(value, _mm_set1_ps(2.0f / 0xffffff)), _mm_set1_ps(1.0f));
+		}
+#endif
+
+		float getNoiseScale(const Settings& settings)
+		{
+			// Normalizes the octaves so that the noise stays within the amplitude.
+			float amplitudeSum = 0.0f;
+			float amplitude = 1.0f;
+			for (unsigned int octave = 0; octave < settings.octaves; octave++)
+			{
+				amplitudeSum += amplitude;
+				amplitude *= settings.persistence;
+			}
+
+			if (amplitudeSum == 0.0f)
+			{
+				return 0.0f;
+			}
+
+			return settings.amplitude / amplitudeSum;
+		}
+
+		float getProfileHeight(const vector<float>& profile, unsigned int edgeLength, unsigned int x, unsigned int z)
+		{
+			// The profile is interpolated so that the rings it is made of do not show.
+			float center = (edgeLength - 1) / 2.0f;
+			float distance = sqrt(pow(x - center, 2.0f) + pow(z - center, 2.0f));
+			unsigned int index = static_cast<unsigned int>(distance);
+
+			if (index + 1 >= profile.size())
+			{
+				return profile.back();
+			}
+
+			return profile[index] + (profile[index + 1] - profile[index]) * (distance - index);
+		}
+
+#if (defined(__SSE2__) || defined(_M_X64)) && !defined(THE_ISLAND_SCALAR)
+		__m128i multiply(__m128i a, __m128i b)
+		{
+			// SSE2 can only multiply the even lanes so the odd lanes are shifted into even ones.
+			__m128i even = _mm_mul_epu32(a, b);
+			__m128i odd = _mm_mul_epu32(_mm_srli_si128(a, 4), _mm_srli_si128(b, 4));
+
+			return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+					_mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+		}
+#endif
+	}
+}
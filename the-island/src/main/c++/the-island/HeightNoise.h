@@ -0,0 +1,70 @@
+/*
+ * Copyright © 2014 Simple Entertainment Limited
+ *
+ * This file is part of The Island.
+ *
+ * The Island is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * The Island is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with The Island. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#ifndef HEIGHTNOISE_H_
+#define HEIGHTNOISE_H_
+
+#include <vector>
+
+#include <simplicity/API.h>
+
+namespace theisland
+{
+	/**
+	 * <p>
+	 * Generates heights from the radial profile of an island plus fractal value noise. Unlike the ring propagation
+	 * each height only depends on its own coordinates so any tile of the height map can be generated on its own, in
+	 * any order and on any thread.
+	 * </p>
+	 */
+	namespace HeightNoise
+	{
+		struct SIMPLE_API Settings
+		{
+			// The most the noise raises or lowers the profile.
+			float amplitude = 1.0f;
+
+			// The frequency of the first octave (per height map cell).
+			float frequency = 0.05f;
+
+			// How much the frequency grows with each octave.
+			float lacunarity = 2.0f;
+
+			unsigned int octaves = 4;
+
+			// How much the amplitude shrinks with each octave.
+			float persistence = 0.5f;
+
+			unsigned int seed = 0;
+		};
+
+		// Generates a whole height map (row by row), split into tiles across the hardware threads.
+		SIMPLE_API void generate(const std::vector<float>& profile, unsigned int edgeLength, const Settings& settings,
+				float* heights);
+
+		// Generates the tile [minX, maxX) x [minZ, maxZ) of a height map with the given edge length. The heights are
+		// written row by row from the start of the tile with the given distance between the starts of the rows.
+		SIMPLE_API void generateTile(const std::vector<float>& profile, unsigned int edgeLength, unsigned int minX,
+				unsigned int minZ, unsigned int maxX, unsigned int maxZ, const Settings& settings, float* heights,
+				unsigned int rowStride);
+
+		// The height of a single cell, the same as the one generateTile gives it.
+		SIMPLE_API float getHeight(const std::vector<float>& profile, unsigned int edgeLength, unsigned int x,
+				unsigned int z, const Settings& settings);
+	}
+}
+
+#endif /* HEIGHTNOISE_H_ */
@@ -0,0 +1,164 @@
+/*
+ * Copyright © 2014 Simple Entertainment Limited
+ *
+ * This file is part of The Island.
+ *
+ * The Island is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * The Island is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with The Island. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <cfloat>
+
+#include "ImpostorAtlas.h"
+
+using namespace simplicity;
+using namespace std;
+
+namespace theisland
+{
+	ImpostorAtlas::ImpostorAtlas(unsigned int impostorCount, unsigned int resolution) :
+		depths(impostorCount * resolution * resolution, -FLT_MAX),
+		impostors(impostorCount),
+		pixels(impostorCount * resolution * resolution * 4, 0),
+		resolution(resolution)
+	{
+		for (unsigned int index = 0; index < impostorCount; index++)
+		{
+			impostors[index].maxCorner = Vector2(0.0f, 0.0f);
+			impostors[index].maxTexCoord = Vector2(static_cast<float>(index + 1) / impostorCount, 1.0f);
+			impostors[index].minCorner = Vector2(0.0f, 0.0f);
+			impostors[index].minTexCoord = Vector2(static_cast<float>(index) / impostorCount, 0.0f);
+		}
+	}
+
+	unsigned int ImpostorAtlas::getHeight() const
+	{
+		return resolution;
+	}
+
+	const ImpostorAtlas::Impostor& ImpostorAtlas::getImpostor(unsigned int index) const
+	{
+		return impostors[index];
+	}
+
+	unsigned int ImpostorAtlas::getImpostorCount() const
+	{
+		return impostors.size();
+	}
+
+	const vector<uint8_t>& ImpostorAtlas::getPixels() const
+	{
+		return pixels;
+	}
+
+	unsigned int ImpostorAtlas::getWidth() const
+	{
+		return resolution * impostors.size();
+	}
+
+	void ImpostorAtlas::render(unsigned int index, const vector<Vertex>& triangles)
+	{
+		if (triangles.empty())
+		{
+			return;
+		}
+
+		// Fit the model into a square so that the picture is not stretched.
+		float minX = FLT_MAX;
+		float maxX = -FLT_MAX;
+		float minY = FLT_MAX;
+		float maxY = -FLT_MAX;
+		for (const Vertex& vertex : triangles)
+		{
+			minX = min(minX, vertex.position.X());
+			maxX = max(maxX, vertex.position.X());
+			minY = min(minY, vertex.position.Y());
+			maxY = max(maxY, vertex.position.Y());
+		}
+
+		float size = max(max(maxX - minX, maxY - minY), FLT_EPSILON);
+		float centerX = (minX + maxX) / 2.0f;
+
+		Impostor& impostor = impostors[index];
+		impostor.minCorner = Vector2(centerX - size / 2.0f, minY);
+		impostor.maxCorner = Vector2(centerX + size / 2.0f, minY + size);
+
+		float pixelsPerUnit = resolution / size;
+		unsigned int width = getWidth();
+		unsigned int offsetX = index * resolution;
+
+		// Lit from above and in front so that the picture is not flat.
+		Vector3 light(0.3f, 0.8f, 0.5f);
+		light.normalize();
+
+		for (unsigned int vertexIndex = 0; vertexIndex + 2 < triangles.size(); vertexIndex += 3)
+		{
+			const Vertex* corners = &triangles[vertexIndex];
+
+			// Pixel coordinates (y down).
+			float x[3];
+			float y[3];
+			for (unsigned int corner = 0; corner < 3; corner++)
+			{
+				x[corner] = (corners[corner].position.X() - impostor.minCorner.X()) * pixelsPerUnit;
+				y[corner] = (impostor.maxCorner.Y() - corners[corner].position.Y()) * pixelsPerUnit;
+			}
+
+			float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+			if (fabs(area) < FLT_EPSILON)
+			{
+				continue;
+			}
+
+			float lighting = 0.5f + 0.5f * fabs(dotProduct(corners[0].normal, light));
+
+			int minPixelX = max(0, static_cast<int>(floor(min(x[0], min(x[1], x[2])))));
+			int maxPixelX = min(static_cast<int>(resolution) - 1, static_cast<int>(ceil(max(x[0], max(x[1], x[2])))));
+			int minPixelY = max(0, static_cast<int>(floor(min(y[0], min(y[1], y[2])))));
+			int maxPixelY = min(static_cast<int>(resolution) - 1, static_cast<int>(ceil(max(y[0], max(y[1], y[2])))));
+
+			for (int pixelY = minPixelY; pixelY <= maxPixelY; pixelY++)
+			{
+				for (int pixelX = minPixelX; pixelX <= maxPixelX; pixelX++)
+				{
+					float sampleX = pixelX + 0.5f;
+					float sampleY = pixelY + 0.5f;
+
+					// Barycentric weights of the pixel center, all of them are positive inside the triangle.
+					float weight0 = ((x[1] - sampleX) * (y[2] - sampleY) - (x[2] - sampleX) * (y[1] - sampleY)) / area;
+					float weight1 = ((x[2] - sampleX) * (y[0] - sampleY) - (x[0] - sampleX) * (y[2] - sampleY)) / area;
+					float weight2 = 1.0f - weight0 - weight1;
+					if (weight0 < 0.0f || weight1 < 0.0f || weight2 < 0.0f)
+					{
+						continue;
+					}
+
+					float depth = corners[0].position.Z() * weight0 + corners[1].position.Z() * weight1 +
+							corners[2].position.Z() * weight2;
+					unsigned int pixel = pixelY * width + offsetX + pixelX;
+					if (depth <= depths[pixel])
+					{
+						continue;
+					}
+					depths[pixel] = depth;
+
+					Vector4 color = corners[0].color * weight0 + corners[1].color * weight1 +
+							corners[2].color * weight2;
+					for (unsigned int channel = 0; channel < 3; channel++)
+					{
+						pixels[pixel * 4 + channel] =
+								static_cast<uint8_t>(min(max(color[channel] * lighting, 0.0f), 1.0f) * 255.0f);
+					}
+					pixels[pixel * 4 + 3] = UINT8_MAX;
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,75 @@
+/*
+ * Copyright © 2014 Simple Entertainment Limited
+ *
+ * This file is part of The Island.
+ *
+ * The Island is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * The Island is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with The Island. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#ifndef IMPOSTORATLAS_H_
+#define IMPOSTORATLAS_H_
+
+#include <cstdint>
+#include <vector>
+
+#include <simplicity/API.h>
+
+namespace theisland
+{
+	/**
+	 * <p>
+	 * Pictures of models rendered on the CPU (looking down the negative Z axis) side by side in one RGBA texture, to
+	 * be drawn on camera facing quads in place of the models when they are far away.
+	 * </p>
+	 */
+	class SIMPLE_API ImpostorAtlas
+	{
+		public:
+			struct Impostor
+			{
+				// The area the picture covers on the model's XY plane.
+				simplicity::Vector2 maxCorner;
+
+				simplicity::Vector2 maxTexCoord;
+
+				simplicity::Vector2 minCorner;
+
+				simplicity::Vector2 minTexCoord;
+			};
+
+			ImpostorAtlas(unsigned int impostorCount, unsigned int resolution);
+
+			unsigned int getHeight() const;
+
+			const Impostor& getImpostor(unsigned int index) const;
+
+			unsigned int getImpostorCount() const;
+
+			// RGBA with 8 bits per channel, the top row first. Pixels nothing was rendered to are transparent.
+			const std::vector<std::uint8_t>& getPixels() const;
+
+			unsigned int getWidth() const;
+
+			// Renders the triangles (three vertices each) into an impostor, scaled to fit.
+			void render(unsigned int index, const std::vector<simplicity::Vertex>& triangles);
+
+		private:
+			std::vector<float> depths;
+
+			std::vector<Impostor> impostors;
+
+			std::vector<std::uint8_t> pixels;
+
+			unsigned int resolution;
+	};
+}
+
+#endif /* IMPOSTORATLAS_H_ */
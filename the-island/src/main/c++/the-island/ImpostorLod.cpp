@@ -0,0 +1,146 @@
+/*
+ * Copyright © 2014 Simple Entertainment Limited
+ *
+ * This file is part of The Island.
+ *
+ * The Island is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * The Island is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with The Island. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include "ImpostorLod.h"
+
+using namespace simplicity;
+using namespace std;
+
+namespace theisland
+{
+	ImpostorLod::ImpostorLod() :
+		atlas(),
+		detailOpacities(),
+		fadeDistance(20.0f),
+		impostorDistance(0.0f),
+		instances(),
+		quads()
+	{
+	}
+
+	void ImpostorLod::add(Entity& entity, const vector<Entity*>& children, unsigned int impostor,
+			const Vector3& position)
+	{
+		Instance instance;
+		instance.children = children;
+		instance.entity = &entity;
+		instance.impostor = impostor;
+		instance.position = position;
+		instances.push_back(instance);
+
+		detailOpacities.push_back(1.0f);
+	}
+
+	void ImpostorLod::clear()
+	{
+		detailOpacities.clear();
+		instances.clear();
+		quads.clear();
+	}
+
+	const vector<float>& ImpostorLod::getDetailOpacities() const
+	{
+		return detailOpacities;
+	}
+
+	const vector<ImpostorLod::Instance>& ImpostorLod::getInstances() const
+	{
+		return instances;
+	}
+
+	const vector<Vertex>& ImpostorLod::getQuads() const
+	{
+		return quads;
+	}
+
+	void ImpostorLod::setAtlas(shared_ptr<const ImpostorAtlas> atlas)
+	{
+		this->atlas = atlas;
+	}
+
+	void ImpostorLod::setDistances(float impostorDistance, float fadeDistance)
+	{
+		this->fadeDistance = fadeDistance;
+		this->impostorDistance = impostorDistance;
+	}
+
+	void ImpostorLod::update(const Vector3& cameraPosition)
+	{
+		quads.clear();
+
+		if (atlas == nullptr || impostorDistance <= 0.0f)
+		{
+			fill(detailOpacities.begin(), detailOpacities.end(), 1.0f);
+			return;
+		}
+
+		float fadeStart = impostorDistance - fadeDistance / 2.0f;
+		Vector3 up(0.0f, 1.0f, 0.0f);
+
+		for (unsigned int index = 0; index < instances.size(); index++)
+		{
+			const Instance& instance = instances[index];
+
+			Vector3 toCamera = cameraPosition - instance.position;
+			toCamera.Y() = 0.0f;
+			float distance = toCamera.getMagnitude();
+
+			float impostorOpacity = 1.0f;
+			if (fadeDistance > 0.0f)
+			{
+				impostorOpacity = min(max((distance - fadeStart) / fadeDistance, 0.0f), 1.0f);
+			}
+			else if (distance < impostorDistance)
+			{
+				impostorOpacity = 0.0f;
+			}
+
+			detailOpacities[index] = 1.0f - impostorOpacity;
+			if (impostorOpacity == 0.0f)
+			{
+				continue;
+			}
+
+			// The quads only turn around the vertical axis so that the impostors stay upright.
+			toCamera /= max(distance, 0.0001f);
+			Vector3 right(toCamera.Z(), 0.0f, -toCamera.X());
+
+			const ImpostorAtlas::Impostor& impostor = atlas->getImpostor(instance.impostor);
+			Vector3 corners[4];
+			Vector2 texCoords[4];
+			corners[0] = instance.position + right * impostor.minCorner.X() + up * impostor.minCorner.Y();
+			corners[1] = instance.position + right * impostor.maxCorner.X() + up * impostor.minCorner.Y();
+			corners[2] = instance.position + right * impostor.maxCorner.X() + up * impostor.maxCorner.Y();
+			corners[3] = instance.position + right * impostor.minCorner.X() + up * impostor.maxCorner.Y();
+
+			// The atlas has its top row first.
+			texCoords[0] = Vector2(impostor.minTexCoord.X(), impostor.maxTexCoord.Y());
+			texCoords[1] = Vector2(impostor.maxTexCoord.X(), impostor.maxTexCoord.Y());
+			texCoords[2] = Vector2(impostor.maxTexCoord.X(), impostor.minTexCoord.Y());
+			texCoords[3] = Vector2(impostor.minTexCoord.X(), impostor.minTexCoord.Y());
+
+			for (unsigned int corner : { 0, 1, 2, 0, 2, 3 })
+			{
+				Vertex vertex;
+				vertex.color = Vector4(1.0f, 1.0f, 1.0f, impostorOpacity);
+				vertex.normal = toCamera;
+				vertex.position = corners[corner];
+				vertex.texCoord = texCoords[corner];
+				quads.push_back(vertex);
+			}
+		}
+	}
+}
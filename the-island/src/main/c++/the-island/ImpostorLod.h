@@ -0,0 +1,91 @@
+/*
+ * Copyright © 2014 Simple Entertainment Limited
+ *
+ * This file is part of The Island.
+ *
+ * The Island is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * The Island is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with The Island. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#ifndef IMPOSTORLOD_H_
+#define IMPOSTORLOD_H_
+
+#include <memory>
+#include <vector>
+
+#include <simplicity/API.h>
+
+#include "ImpostorAtlas.h"
+
+namespace theisland
+{
+	/**
+	 * <p>
+	 * Swaps distant instances of models for camera facing quads showing their impostors, cross-fading between the
+	 * two around the impostor distance. The host calls update every frame, fades the full detail instances (their
+	 * entities and all of their children) by their detail opacities and draws the quads with the atlas.
+	 * </p>
+	 */
+	class SIMPLE_API ImpostorLod
+	{
+		public:
+			struct Instance
+			{
+				// The children of the full detail instance that are faded with it (they belong to the scene).
+				std::vector<simplicity::Entity*> children;
+
+				// The full detail instance (it belongs to the scene).
+				simplicity::Entity* entity;
+
+				unsigned int impostor;
+
+				simplicity::Vector3 position;
+			};
+
+			ImpostorLod();
+
+			void add(simplicity::Entity& entity, const std::vector<simplicity::Entity*>& children,
+					unsigned int impostor, const simplicity::Vector3& position);
+
+			void clear();
+
+			// How opaque the full detail of each instance should be drawn (0 for not at all).
+			const std::vector<float>& getDetailOpacities() const;
+
+			const std::vector<Instance>& getInstances() const;
+
+			// The camera facing quads (six vertices each) of the instances that are far enough away, with their
+			// opacities in the alpha of their colors.
+			const std::vector<simplicity::Vertex>& getQuads() const;
+
+			// Instances further away than the distance are drawn as impostors, the cross-fade covers the fade distance
+			// around it (0 disables impostors).
+			void setDistances(float impostorDistance, float fadeDistance);
+
+			void setAtlas(std::shared_ptr<const ImpostorAtlas> atlas);
+
+			void update(const simplicity::Vector3& cameraPosition);
+
+		private:
+			std::shared_ptr<const ImpostorAtlas> atlas;
+
+			std::vector<float> detailOpacities;
+
+			float fadeDistance;
+
+			float impostorDistance;
+
+			std::vector<Instance> instances;
+
+			std::vector<simplicity::Vertex> quads;
+	};
+}
+
+#endif /* IMPOSTORLOD_H_ */
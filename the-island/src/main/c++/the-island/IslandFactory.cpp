@@ -14,365 +14,1518 @@
  * You should have received a copy of the GNU General Public License along with The Island. If not, see
  * <http://www.gnu.org/licenses/>.
  */
+#include <cfloat>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <fstream>
+#include <future>
+#include <random>
+
+#include "Arena.h"
+#include "Biomes.h"
+#include "Checksums.h"
+#include "CompactMesh.h"
 #include "EntityCategories.h"
+#include "Erosion.h"
+#include "FoliagePlacement.h"
+#include "HeightMapFunctions.h"
 #include "IslandFactory.h"
 #include "RockFactory.h"
+#include "SceneBatch.h"
+#include "StagingBuffer.h"
+#include "TerrainLighting.h"
+#include "TerrainTriangulator.h"
 #include "TreeFactory.h"
 
 using namespace simplicity;
 using namespace std;
 
 static const unsigned int CLIFF_SUBDIVIDE_MAX_DEPTH = 3;
-static const unsigned int GRASS_BLADE_COUNT = 20;
-static const unsigned int ROCK_DETAIL = 10;
+static const unsigned int CLIFF_SUBDIVIDE_MAX_TRIANGLES = 27;
+static const unsigned int ENTITIES_PER_STEP = 256;
+static const unsigned int PROXY_SIDES = 6;
+static const unsigned int ROCKS_PER_STEP = 64;
 
 namespace theisland
 {
 	namespace IslandFactory
 	{
-		void addDetail(MeshData& meshData, unsigned int vertexIndex);
-		void addFoliage();
-		unsigned int adjustIndex(unsigned int index, int adjustment, string adjustmentAxis, string axis, int direction);
-		void divideTriangle(MeshData& meshData, unsigned int vertexIndex, unsigned int maxDepth, unsigned int depth = 1);
-		void fillHeightMapSector(unsigned int radius, const vector<float>& profile, vector<vector<float>>& heightMap,
-				vector<vector<float>>& slopeMap, string axis, int direction);
-		float getAdjusted(const vector<vector<float>>& heightMap, unsigned int x, unsigned int z, int adjustment,
-				string axis, int direction);
-		void getFactors(unsigned int x, unsigned int z, const vector<vector<float>>& heightMap,
-				const vector<vector<float>>& slopeMap, string axis, int direction, unsigned int beginIndex,
+		struct CliffTriangle
+		{
+			unsigned int depth;
+
+			float priority;
+
+			unsigned int vertexIndex;
+		};
+
+		struct CollisionChunk
+		{
+			vector<unsigned int> indices;
+
+			vector<Vector3> vertices;
+		};
+
+		// An island part way through being created.
+		struct Generation
+		{
+			Generation(Arena& arena) :
+				adaptiveTerrain(false),
+				arena(arena),
+				batch(),
+				biomeBuckets(arena),
+				biomes(arena),
+				cached(false),
+				cacheKey(0),
+				chunkCount(0),
+				chunkProxies(arena),
+				chunks(),
+				chunkSize(0),
+				cliffs(arena),
+				cliffWeights(),
+				collisionBuffer(),
+				collisionChunks(),
+				collisionCutoffHeight(-FLT_MAX),
+				cutoff(false),
+				cutoffHeight(-FLT_MAX),
+				edgeLength(0),
+				erosionDuration(chrono::steady_clock::duration::zero()),
+				erosionTiles(arena),
+				errorMap(arena),
+				flatnesses(arena),
+				foliageCandidates(arena),
+				foliageHash(),
+				foliageOrder(arena),
+				foliageSettings(),
+				futureCollisionChunks(),
+				generatedHeightMap(arena),
+				generatedHeights(arena),
+				generatedMaxHeight(-FLT_MAX),
+				generatedMinHeight(FLT_MAX),
+				grassPositions(arena),
+				heightMap(),
+				heightSeed(0),
+				lightMap(arena),
+				maxHeights(arena),
+				navigationGrid(),
+				profile(),
+				proxies(arena),
+				proxyBuffer(),
+				radialProfile(arena),
+				radius(0),
+				random(),
+				removeSubmergedTerrain(false),
+				rockBuffer(),
+				rockPositions(arena),
+				rockRadii(arena),
+				rocks(),
+				rockStaging(),
+				settings(),
+				slopeMap(arena),
+				stage(0),
+				stagedChunks(),
+				step(0),
+				stepDurations(),
+				terrainBuffer(),
+				terrainStaging(),
+				thermalHeights(arena),
+				threaded(false),
+				totalCliffWeight(0.0f),
+				treePositions(arena),
+				triangles(arena),
+				triangulatable(false)
+			{
+			}
+
+			bool adaptiveTerrain;
+
+			// Everything that is only needed while the island is being created is allocated from here. The arena
+			// outlives the generation and is released when the next island is started so that its memory is reused.
+			Arena& arena;
+
+			// Everything is added to the scene together once the island is complete.
+			SceneBatch batch;
+
+			// The triangles of the chunk being detailed sorted by biome.
+			ArenaVector<ArenaVector<unsigned int>> biomeBuckets;
+
+			ArenaVector<unsigned char> biomes;
+
+			bool cached;
+
+			// What the heights were generated from, stored with the cached height map.
+			std::uint64_t cacheKey;
+
+			unsigned int chunkCount;
+
+			// The proxies grouped by the chunk they stand in while the foliage bodies are created.
+			ArenaVector<ArenaVector<CollisionProxy>> chunkProxies;
+
+			vector<unique_ptr<Entity>> chunks;
+
+			unsigned int chunkSize;
+
+			ArenaVector<CliffTriangle> cliffs;
+
+			vector<float> cliffWeights;
+
+			// The buffer the collision meshes are created in one chunk at a time.
+			shared_ptr<MeshBuffer> collisionBuffer;
+
+			// Built with each chunk when no threads can be spared.
+			vector<CollisionChunk> collisionChunks;
+
+			float collisionCutoffHeight;
+
+			bool cutoff;
+
+			float cutoffHeight;
+
+			unsigned int edgeLength;
+
+			// How long the erosion has taken so far when it is eroded a step at a time.
+			chrono::steady_clock::duration erosionDuration;
+
+			// The order the tiles are eroded hydraulically in when the height map is eroded a step at a time.
+			ArenaVector<unsigned int> erosionTiles;
+
+			ArenaMap errorMap;
+
+			// The flatness of each triangle of the chunk being detailed.
+			ArenaVector<float> flatnesses;
+
+			ArenaVector<ArenaVector<FoliagePlacement::Candidate>> foliageCandidates;
+
+			// Keeps the foliage of the chunks apart when it is placed one chunk at a time.
+			unique_ptr<SpatialHash> foliageHash;
+
+			// The order the chunks are placed in when the foliage is placed one chunk at a time.
+			ArenaVector<unsigned int> foliageOrder;
+
+			FoliagePlacement::Settings foliageSettings;
+
+			// Built on another thread while the chunks are created when threads can be spared.
+			future<vector<CollisionChunk>> futureCollisionChunks;
+
+			ArenaMap generatedHeightMap;
+
+			ArenaVector<float> generatedHeights;
+
+			// The range of the generated heights, found a row at a time.
+			float generatedMaxHeight;
+
+			float generatedMinHeight;
+
+			ArenaVector<Triangle> grassPositions;
+
+			// The decoded height map is what the engine's height map meshes and the navigation grid are built from so
+			// it is not allocated from the arena.
+			vector<vector<float>> heightMap;
+
+			// The heights are generated from this one random number whether they are cached or not so that the rest
+			// of the island is the same either way.
+			unsigned int heightSeed;
+
+			ArenaMap lightMap;
+
+			ArenaVector<float> maxHeights;
+
+			// The navigation grid while it is built a step at a time.
+			unique_ptr<NavigationGrid> navigationGrid;
+
+			vector<float> profile;
+
+			ArenaVector<CollisionProxy> proxies;
+
+			// The buffer the foliage bodies' meshes are created in one chunk at a time.
+			shared_ptr<MeshBuffer> proxyBuffer;
+
+			ArenaVector<float> radialProfile;
+
+			unsigned int radius;
+
+			mt19937 random;
+
+			bool removeSubmergedTerrain;
+
+			// The buffer the rock meshes are uploaded into a batch at a time.
+			shared_ptr<MeshBuffer> rockBuffer;
+
+			ArenaVector<Vector3> rockPositions;
+
+			ArenaVector<float> rockRadii;
+
+			// The rocks while their meshes are staged and uploaded.
+			vector<unique_ptr<Entity>> rocks;
+
+			StagingBuffer rockStaging;
+
+			Settings settings;
+
+			ArenaMap slopeMap;
+
+			unsigned int stage;
+
+			vector<unsigned int> stagedChunks;
+
+			unsigned int step;
+
+			// How long the last step of each stage took.
+			vector<chrono::steady_clock::duration> stepDurations;
+
+			// The buffer the terrain meshes are uploaded into one chunk at a time.
+			shared_ptr<MeshBuffer> terrainBuffer;
+
+			// The chunks are detailed in memory and then uploaded together.
+			StagingBuffer terrainStaging;
+
+			// The thermally eroded heights while the heights are eroded a step at a time.
+			ArenaVector<float> thermalHeights;
+
+			bool threaded;
+
+			float totalCliffWeight;
+
+			ArenaVector<Vector3> treePositions;
+
+			// The triangles of the chunk being triangulated adaptively.
+			ArenaVector<TerrainTriangulator::GridPoint> triangles;
+
+			bool triangulatable;
+		};
+
+		// Takes one step of a stage of creating an island and returns true if the stage is complete.
+		typedef bool (*Stage)(Generation& generation, unsigned int step);
+
+		void addCliffWeights(const vector<vector<float>>& heightMap, unsigned int chunkSize, unsigned int chunkX,
+				vector<float>& cliffWeights);
+		MeshData& addDetail(Generation& generation, MeshData& meshData, float cutoffHeight, unsigned int cliffBudget);
+		bool addFoliageBodies(Generation& generation, unsigned int step);
+		bool addRocks(Generation& generation, unsigned int step);
+		bool addSkyAndOcean(Generation& generation, unsigned int);
+		bool addToScene(Generation& generation, unsigned int);
+		bool addTrees(Generation& generation, unsigned int step);
+		unsigned int adjustIndex(unsigned int index, int adjustment, const string& adjustmentAxis, const string& axis,
+				int direction);
+		bool advance(Generation& generation);
+		void applyLighting(MeshData& meshData, const ArenaMap& lightMap);
+		bool bakeLighting(Generation& generation, unsigned int step);
+		bool buildNavigation(Generation& generation, unsigned int step);
+		unique_ptr<Entity> createChunk(Generation& generation, unsigned int x, unsigned int z);
+		bool createChunks(Generation& generation, unsigned int step);
+		bool createCollisionBodies(Generation& generation, unsigned int step);
+		CollisionChunk createCollisionChunk(const vector<vector<float>>& heightMap, const ArenaMap& errorMap,
+				unsigned int minX, unsigned int minZ, unsigned int chunkSize, float tolerance, float cutoffHeight,
+				ArenaVector<TerrainTriangulator::GridPoint>& triangles);
+		vector<CollisionChunk> createCollisionChunks(const vector<vector<float>>& heightMap, const ArenaMap& errorMap,
+				unsigned int chunkSize, float tolerance, float cutoffHeight);
+		unique_ptr<Mesh> createCollisionMesh(const CollisionChunk& collisionChunk, shared_ptr<MeshBuffer> buffer);
+		void createFoliageBody(const ArenaVector<CollisionProxy>& proxies, shared_ptr<MeshBuffer> buffer,
+				SceneBatch& batch);
+		unique_ptr<Body> createHeightMapBody(const vector<vector<float>>& heightMap, unsigned int minX,
+				unsigned int minZ, unsigned int chunkSize, const Matrix44& transform);
+		bool decodeHeights(Generation& generation, unsigned int step);
+		void divideCliffs(MeshData& meshData, const ArenaVector<CliffTriangle>& cliffs);
+		void divideTriangle(const Vertex* triangle, Vertex* dividedTriangles);
+		bool erodeHeights(Generation& generation, unsigned int step);
+		void fillHeightMapRing(unsigned int radius, unsigned int currentRadius, const ArenaVector<float>& radialProfile,
+				ArenaMap& heightMap, ArenaMap& slopeMap, const string& axis, int direction, mt19937& random);
+		bool generateHeights(Generation& generation, unsigned int step);
+		void generateNoiseHeightMap(unsigned int edgeLength, const vector<float>& profile,
+				const HeightNoise::Settings& settings, ArenaVector<float>& heights);
+		uint64_t getCacheKey(const Generation& generation);
+		float getAdjusted(const ArenaMap& source, unsigned int x, unsigned int z, int adjustment,
+				const string& axis, int direction);
+		void getFactors(unsigned int x, unsigned int z, const ArenaMap& heightMap, const ArenaMap& slopeMap,
+				const string& axis, int direction, unsigned int beginIndex,
 				unsigned int endIndex, float& heightFactor, float& slopeFactor);
+		float getMaxHeight(const vector<vector<float>>& heightMap, unsigned int minX, unsigned int minZ,
+				unsigned int chunkSize);
+		unsigned int getProxyIndexCount(const CollisionProxy& proxy);
+		unsigned int getProxyVertexCount(const CollisionProxy& proxy);
+		ArenaVector<float> getRadialProfile(unsigned int radius, const vector<float>& profile, Arena& arena);
 		Vector3 getSmoothNormal(MeshData& meshData, unsigned int x, unsigned int z);
-		void getTraversalIndices(unsigned int radius, unsigned int currentRadius, string axis, int direction,
+		void getTraversalIndices(unsigned int radius, unsigned int currentRadius, const string& axis, int direction,
 				unsigned int& beginIndexX, unsigned int& endIndexX, unsigned int& beginIndexZ, unsigned int& endIndexZ);
-		void growGrass(const Triangle& ground, shared_ptr<MeshBuffer> buffer);
-		void initializeMaps(vector<vector<float>>& heightMap, vector<vector<float>>& slopeMap, unsigned int edgeLength);
-		void setHeight(unsigned int radius, const vector<float>& profile, unsigned int x, unsigned int z,
-				vector<vector<float>>& heightMap, vector<vector<float>>& slopeMap, float heightFactor);
-		void smoothen(MeshData& meshData, unsigned int vertexIndex);
+		Body::Material getStaticMaterial();
+		void groupProxies(const vector<vector<float>>& heightMap, unsigned int chunkSize,
+				const ArenaVector<CollisionProxy>& proxies, ArenaVector<ArenaVector<CollisionProxy>>& chunkProxies);
+		void initializeMaps(ArenaMap& heightMap, ArenaMap& slopeMap, unsigned int edgeLength);
+		void insertAdaptiveVertices(const vector<vector<float>>& heightMap, const ArenaMap& errorMap,
+				unsigned int minX, unsigned int minZ, unsigned int chunkSize, float tolerance,
+				ArenaVector<TerrainTriangulator::GridPoint>& triangles, MeshData& meshData);
+		void insertHeightMapVertices(const vector<vector<float>>& heightMap, unsigned int minX, unsigned int minZ,
+				unsigned int chunkSize, MeshData& meshData);
+		void insertProxy(MeshData& meshData, const CollisionProxy& proxy);
+		bool isSubmerged(const MeshData& meshData, unsigned int vertexIndex, float cutoffHeight);
+		bool loadHeightMap(const string& path, uint64_t key, unsigned int edgeLength,
+				QuantizedHeightMap& quantizedHeightMap);
+		bool loadHeights(Generation& generation, unsigned int);
+		bool placeFoliage(Generation& generation, unsigned int step);
+		unsigned int planCliffs(const MeshData& meshData, const ArenaVector<unsigned int>& cliffIndices,
+				unsigned int budget, ArenaVector<CliffTriangle>& cliffs);
+		bool prepareChunks(Generation& generation, unsigned int step);
+		bool quantizeHeights(Generation& generation, unsigned int step);
+		void removeSubmerged(MeshData& meshData, float cutoffHeight);
+		void saveHeightMap(const string& path, uint64_t key, const QuantizedHeightMap& quantizedHeightMap);
+		void setHeight(unsigned int radius, const ArenaVector<float>& radialProfile, unsigned int x, unsigned int z,
+				ArenaMap& heightMap, ArenaMap& slopeMap, float heightFactor, mt19937& random);
+		void smoothen(MeshData& meshData, unsigned int vertexIndex, const vector<vector<float>>& heightMap,
+				bool adaptive);
+		void startIsland(unsigned int radius, const vector<float>& profile, unsigned int chunkSize,
+				const Settings& settings, bool threaded);
+		bool uploadTerrain(Generation& generation, unsigned int step);
+
+		// The stages of creating an island in the order they are taken.
+		const Stage STAGES[] = { loadHeights, generateHeights, erodeHeights, quantizeHeights, decodeHeights,
+				bakeLighting, prepareChunks, createChunks, placeFoliage, uploadTerrain, createCollisionBodies, addRocks,
+				addTrees, addFoliageBodies, buildNavigation, addSkyAndOcean, addToScene };
+		const unsigned int STAGE_COUNT = sizeof(STAGES) / sizeof(Stage);
+
+		// The chunk bodies are created from these meshes so they are kept alive here until the island is removed.
+		vector<unique_ptr<Mesh>> collisionMeshes;
+
+		// The generations allocate from this one after the other.
+		Arena islandArena;
+
+		// The entities of the island added to the scene without a parent (their children go with them).
+		vector<Entity*> islandEntities;
+
+		// Only the quantized height map is kept once the island has been created.
+		QuantizedHeightMap islandHeightMap;
+
+		Checksums::IslandChecksums islandChecksums;
+
+		NavigationGrid navigationGrid;
+
+		unique_ptr<OceanClipmap> oceanClipmap;
+
+		// The island being created (if it is not complete yet).
+		unique_ptr<Generation> generation;
+
+		void addCliffWeights(const vector<vector<float>>& heightMap, unsigned int chunkSize, unsigned int chunkX,
+				vector<float>& cliffWeights)
+		{
+			unsigned int chunksPerEdge = (heightMap.size() - 1) / chunkSize;
+
+			Vector3 up(0.0f, 1.0f, 0.0f);
+
+			// Estimates the cliffs of a row of chunks from the two triangles of each height map cell.
+			for (unsigned int x = chunkX * chunkSize; x < (chunkX + 1) * chunkSize; x++)
+			{
+				for (unsigned int z = 0; z < chunksPerEdge * chunkSize; z++)
+				{
+					Vector3 point0(0.0f, heightMap[x][z], 0.0f);
+					Vector3 point1(0.0f, heightMap[x][z + 1], 1.0f);
+					Vector3 point2(1.0f, heightMap[x + 1][z + 1], 1.0f);
+					Vector3 point3(1.0f, heightMap[x + 1][z], 0.0f);
+
+					Vector3 normals[2] =
+					{
+						crossProduct(point1 - point0, point2 - point0),
+						crossProduct(point2 - point0, point3 - point0)
+					};
+
+					for (Vector3& normal : normals)
+					{
+						float area = normal.getMagnitude() / 2.0f;
+						normal.normalize();
+						float flatness = fabs(dotProduct(normal, up));
+
+						if (flatness < 0.2f)
+						{
+							cliffWeights[(x / chunkSize) * chunksPerEdge + z / chunkSize] += area * (1.0f - flatness);
+						}
+					}
+				}
+			}
+		}
+
+		MeshData& addDetail(Generation& generation, MeshData& meshData, float cutoffHeight, unsigned int cliffBudget)
+		{
+			ArenaVector<ArenaVector<unsigned int>>& biomeBuckets = generation.biomeBuckets;
+			ArenaVector<unsigned char>& biomes = generation.biomes;
+			ArenaVector<float>& maxHeights = generation.maxHeights;
+
+			Biomes::classify(meshData, cutoffHeight, generation.flatnesses, maxHeights, biomes);
+			Biomes::sort(biomes, biomeBuckets);
+
+			// Colors!
+			/////////////////////////
+			for (unsigned char biome = 0; biome < Biomes::BIOME_COUNT; biome++)
+			{
+				if (biome == Biomes::SUBMERGED)
+				{
+					continue;
+				}
+
+				Vector4 color = Biomes::getColor(biome);
+				for (unsigned int vertexIndex : biomeBuckets[biome])
+				{
+					meshData[vertexIndex].color = color;
+					meshData[vertexIndex + 1].color = color;
+					meshData[vertexIndex + 2].color = color;
+				}
+			}
+
+			// Rocks and trees! (they are placed once every chunk has been detailed)
+			/////////////////////////
+			ArenaVector<FoliagePlacement::Candidate>& candidates = generation.foliageCandidates.back();
+			candidates.reserve(biomes.size());
+			for (unsigned int triangle = 0; triangle < biomes.size(); triangle++)
+			{
+				if (biomes[triangle] != Biomes::SUBMERGED)
+				{
+					FoliagePlacement::Candidate candidate;
+					candidate.biome = biomes[triangle];
+					candidate.maxHeight = maxHeights[triangle];
+					candidate.vertices[0] = meshData[triangle * 3].position;
+					candidate.vertices[1] = meshData[triangle * 3 + 1].position;
+					candidate.vertices[2] = meshData[triangle * 3 + 2].position;
+					candidates.push_back(candidate);
+				}
+			}
+
+			// Grass!
+			/////////////////////////
+			for (unsigned int vertexIndex : biomeBuckets[Biomes::GRASS])
+			{
+				generation.grassPositions.push_back(Triangle(meshData[vertexIndex].position,
+						meshData[vertexIndex + 1].position, meshData[vertexIndex + 2].position));
+			}
+
+			// Everything but the cliffs is smooth. The cliffs have to be divided last because smoothing reads the
+			// positions of the neighbouring triangles.
+			for (unsigned char biome : { Biomes::BEACH, Biomes::GRASS, Biomes::SNOW })
+			{
+				for (unsigned int vertexIndex : biomeBuckets[biome])
+				{
+					smoothen(meshData, vertexIndex, generation.heightMap, generation.adaptiveTerrain);
+				}
+			}
+
+			// The divided cliffs are written after the rest of the chunk so it is given room for them first.
+			unsigned int cliffVertexCount =
+					planCliffs(meshData, biomeBuckets[Biomes::CLIFF], cliffBudget, generation.cliffs);
+			MeshData& detailedData = generation.terrainStaging.grow(meshData.vertexCount + cliffVertexCount, 0);
+			divideCliffs(detailedData, generation.cliffs);
+
+			return detailedData;
+		}
+
+		bool addFoliageBodies(Generation& generation, unsigned int step)
+		{
+			ArenaVector<ArenaVector<CollisionProxy>>& chunkProxies = generation.chunkProxies;
+
+			if (step == 0)
+			{
+				groupProxies(generation.heightMap, generation.chunkSize, generation.proxies, chunkProxies);
+
+				unsigned int proxyVertexCount = 0;
+				unsigned int proxyIndexCount = 0;
+				for (const CollisionProxy& proxy : generation.proxies)
+				{
+					proxyVertexCount += getProxyVertexCount(proxy);
+					proxyIndexCount += getProxyIndexCount(proxy);
+				}
+
+				if (proxyVertexCount > 0)
+				{
+					generation.proxyBuffer = ModelFactory::getInstance()->createMeshBuffer(proxyVertexCount,
+							proxyIndexCount, Buffer::AccessHint::READ);
+				}
+			}
+
+			if (generation.threaded)
+			{
+				for (const ArenaVector<CollisionProxy>& proxiesInChunk : chunkProxies)
+				{
+					createFoliageBody(proxiesInChunk, generation.proxyBuffer, generation.batch);
+				}
+			}
+			else
+			{
+				// One chunk at a time.
+				if (step < chunkProxies.size())
+				{
+					createFoliageBody(chunkProxies[step], generation.proxyBuffer, generation.batch);
+				}
+
+				if (step + 1 < chunkProxies.size())
+				{
+					return false;
+				}
+			}
+
+			chunkProxies.clear();
+			generation.proxyBuffer.reset();
+
+			if (generation.settings.checksums)
+			{
+				islandChecksums.foliageBodies = Checksums::hashProxies(generation.proxies.data(),
+						generation.proxies.size(), generation.settings.checksumTolerance);
+			}
+
+			return true;
+		}
+
+		bool addRocks(Generation& generation, unsigned int step)
+		{
+			SceneBatch& batch = generation.batch;
+			ArenaVector<Vector3>& rockPositions = generation.rockPositions;
+			ArenaVector<float>& rockRadii = generation.rockRadii;
+			vector<unique_ptr<Entity>>& rocks = generation.rocks;
+			StagingBuffer& rockStaging = generation.rockStaging;
+			unsigned int rockCount = rockPositions.size();
+
+			if (step == 0)
+			{
+				unsigned int chunkEntityCount = 0;
+				for (unique_ptr<Entity>& chunk : generation.chunks)
+				{
+					if (chunk != nullptr)
+					{
+						chunkEntityCount++;
+					}
+				}
+
+				// Everything the island adds to the scene: the chunks, rocks, trees, foliage bodies (at most one per
+				// chunk) and the sky and ocean.
+				unsigned int treeEntityCount = generation.treePositions.size() * TreeFactory::getEntityCount();
+				unsigned int foliageBodyCount = generation.chunkCount;
+				batch.reserve(chunkEntityCount + rockCount + treeEntityCount + foliageBodyCount + 2);
+
+				for (unique_ptr<Entity>& chunk : generation.chunks)
+				{
+					if (chunk != nullptr)
+					{
+						batch.add(move(chunk));
+					}
+				}
+
+				if (generation.settings.checksums)
+				{
+					islandChecksums.grass = Checksums::hashTriangles(generation.grassPositions.data(),
+							generation.grassPositions.size(), generation.settings.checksumTolerance);
+				}
+				generation.grassPositions.clear();
+
+				ArenaVector<CollisionProxy>& proxies = generation.proxies;
+				proxies.reserve(rockCount + generation.treePositions.size());
+				proxies.resize(rockCount);
+
+				// The rocks are built in memory together and then uploaded into one buffer.
+				rockRadii.reserve(rockCount);
+				for (unsigned int index = 0; index < rockCount; index++)
+				{
+					rockRadii.push_back(getRandomFloat(0.25f, 0.75f));
+				}
+
+				generation.random.seed(getRandomInt(0, INT_MAX));
+				rocks.resize(rockCount);
+				RockFactory::reserveRocks(rockCount, rockStaging);
+			}
+
+			if (generation.threaded)
+			{
+				RockFactory::createRocks(rockPositions.data(), rockRadii.data(), rockCount, generation.random,
+						rockStaging, rocks.data(), generation.proxies.data());
+
+				vector<unique_ptr<Mesh>> rockMeshes = rockStaging.upload(Buffer::AccessHint::NONE);
+				for (unsigned int index = 0; index < rockCount; index++)
+				{
+					rocks[index]->addUniqueComponent(move(rockMeshes[index]));
+					batch.add(move(rocks[index]));
+				}
+			}
+			else if (rockCount > 0)
+			{
+				// One batch of rocks is staged at a time and then, once they have all been staged, one batch is
+				// uploaded at a time.
+				unsigned int batchCount = (rockCount + ROCKS_PER_STEP - 1) / ROCKS_PER_STEP;
+				unsigned int first = (step % batchCount) * ROCKS_PER_STEP;
+				unsigned int count = min(ROCKS_PER_STEP, rockCount - first);
+
+				if (step < batchCount)
+				{
+					RockFactory::createRocks(rockPositions.data() + first, rockRadii.data() + first, count,
+							generation.random, rockStaging, rocks.data() + first, generation.proxies.data() + first);
+				}
+				else
+				{
+					if (step == batchCount)
+					{
+						generation.rockBuffer = rockStaging.createBuffer(Buffer::AccessHint::NONE);
+					}
+
+					for (unsigned int index = first; index < first + count; index++)
+					{
+						rocks[index]->addUniqueComponent(rockStaging.upload(index, generation.rockBuffer));
+						batch.add(move(rocks[index]));
+					}
+				}
+
+				if (step + 1 < batchCount * 2)
+				{
+					return false;
+				}
+			}
+
+			generation.rockBuffer.reset();
+			rockPositions.clear();
+			rockRadii.clear();
+			rocks.clear();
+			rockStaging.clear();
+
+			return true;
+		}
+
+		bool addSkyAndOcean(Generation& generation, unsigned int)
+		{
+			SceneBatch& batch = generation.batch;
+
+			// The Sky!
+			/////////////////////////
+			unique_ptr<Entity> sky(new Entity(EntityCategories::SKY));
+			rotate(sky->getTransform(), MathConstants::PI * -0.5f, Vector3(1.0f, 0.0f, 0.0f));
+
+			unique_ptr<Mesh> skyMesh = ModelFactory::getInstance()->createHemisphereMesh(1100.0f, 20,
+					shared_ptr<MeshBuffer>(), Vector4(0.0f, 0.5f, 0.75f, 1.0f), true);
+
+			sky->addUniqueComponent(move(skyMesh));
+			batch.add(move(sky));
+
+			// The Ocean!
+			/////////////////////////
+			unique_ptr<Entity> ocean(new Entity(EntityCategories::WATER));
+
+			if (generation.settings.clipmapOcean)
+			{
+				oceanClipmap.reset(new OceanClipmap);
+
+				OceanClipmap::Wave wave;
+				wave.amplitude = 0.4f;
+				wave.direction = Vector2(0.8f, 0.6f);
+				wave.steepness = 0.5f;
+				wave.wavelength = 24.0f;
+				oceanClipmap->addWave(wave);
+
+				wave.amplitude = 0.2f;
+				wave.direction = Vector2(-0.6f, 0.8f);
+				wave.wavelength = 11.0f;
+				oceanClipmap->addWave(wave);
+
+				wave.amplitude = 0.1f;
+				wave.direction = Vector2(0.0f, -1.0f);
+				wave.wavelength = 5.0f;
+				oceanClipmap->addWave(wave);
+
+				ocean->addSharedComponent(oceanClipmap->getMesh());
+			}
+			else
+			{
+				oceanClipmap.reset();
+				rotate(ocean->getTransform(), MathConstants::PI * -0.5f, Vector3(1.0f, 0.0f, 0.0f));
+
+				unique_ptr<Mesh> oceanMesh =
+						ModelFactory::getInstance()->createCylinderMesh(1200.0f, 500.0f, 20, shared_ptr<MeshBuffer>(),
+								Vector4(0.0f, 0.4f, 0.6f, 1.0f), true);
+
+				ocean->addUniqueComponent(move(oceanMesh));
+			}
+
+			batch.add(move(ocean));
+
+			return true;
+		}
+
+		bool addToScene(Generation& generation, unsigned int)
+		{
+			if (generation.threaded)
+			{
+				generation.batch.commit(islandEntities);
+
+				return true;
+			}
+
+			// A slice of the entities at a time.
+			return generation.batch.commit(ENTITIES_PER_STEP, islandEntities);
+		}
+
+		bool addTrees(Generation& generation, unsigned int step)
+		{
+			ArenaVector<Vector3>& treePositions = generation.treePositions;
+			if (step < treePositions.size())
+			{
+				generation.proxies.push_back(TreeFactory::createTree(treePositions[step], generation.batch));
+			}
+
+			if (step + 1 < treePositions.size())
+			{
+				return false;
+			}
+
+			treePositions.clear();
+
+			return true;
+		}
+
+		unsigned int adjustIndex(unsigned int index, int adjustment, const string& adjustmentAxis, const string& axis,
+				int direction)
+		{
+			if (adjustmentAxis == axis)
+			{
+				return index - direction;
+			}
+			else
+			{
+				return index + adjustment;
+			}
+		}
+
+		bool advance(Generation& generation)
+		{
+			if (STAGES[generation.stage](generation, generation.step))
+			{
+				generation.stage++;
+				generation.step = 0;
+			}
+			else
+			{
+				generation.step++;
+			}
+
+			return generation.stage < STAGE_COUNT;
+		}
+
+		void applyLighting(MeshData& meshData, const ArenaMap& lightMap)
+		{
+			for (unsigned int index = 0; index < meshData.vertexCount; index++)
+			{
+				float x = 0.0f;
+				float z = 0.0f;
+				HeightMapFunctions::getCoordinates(lightMap.size(), meshData[index].position, x, z);
+
+				float light = TerrainLighting::getLight(lightMap, x, z);
+				Vector4& color = meshData[index].color;
+				color.X() *= light;
+				color.Y() *= light;
+				color.Z() *= light;
+			}
+		}
+
+		bool bakeLighting(Generation& generation, unsigned int step)
+		{
+			if (!generation.settings.bakeLighting)
+			{
+				return true;
+			}
+
+			if (generation.threaded)
+			{
+				TerrainLighting::bake(generation.heightMap, generation.settings.lighting, generation.lightMap);
+
+				return true;
+			}
+
+			// One row at a time.
+			TerrainLighting::bakeRows(generation.heightMap, generation.settings.lighting, step, step + 1,
+					generation.lightMap);
+
+			return step == generation.edgeLength - 1;
+		}
+
+		void beginIsland(unsigned int radius, const vector<float>& profile, unsigned int chunkSize,
+				const Settings& settings)
+		{
+			startIsland(radius, profile, chunkSize, settings, false);
+		}
+
+		bool buildNavigation(Generation& generation, unsigned int step)
+		{
+			const Settings& settings = generation.settings;
+
+			if (settings.buildNavigation && !generation.threaded)
+			{
+				// One chunk at a time.
+				if (step == 0)
+				{
+					generation.navigationGrid.reset(new NavigationGrid(generation.heightMap, generation.chunkSize));
+				}
+
+				if (!generation.navigationGrid->build(generation.heightMap, generation.proxies.data(),
+						generation.proxies.size(), settings.navigation, step))
+				{
+					return false;
+				}
+
+				navigationGrid = move(*generation.navigationGrid);
+				generation.navigationGrid.reset();
+			}
+			else if (settings.buildNavigation)
+			{
+				navigationGrid = NavigationGrid(generation.heightMap, generation.chunkSize, generation.proxies.data(),
+						generation.proxies.size(), settings.navigation);
+			}
+			else
+			{
+				navigationGrid = NavigationGrid();
+			}
+
+			generation.proxies.clear();
+
+			return true;
+		}
+
+		bool continueIsland(unsigned int budget)
+		{
+			chrono::steady_clock::time_point start = chrono::steady_clock::now();
+			chrono::steady_clock::duration limit = chrono::microseconds(budget);
+			chrono::steady_clock::duration lastDuration = chrono::steady_clock::duration::zero();
+			bool advanced = false;
+
+			while (generation != nullptr)
+			{
+				// Steps are not started if the last step of the same stage would not have fit in what is left of the
+				// budget. The first step of a stage is expected to take as long as the last step taken, so that a
+				// call that has already spent most of its budget stops at the stage boundary. At least one step is
+				// always taken so that the island is always completed eventually.
+				chrono::steady_clock::time_point stepStart = chrono::steady_clock::now();
+				unsigned int stage = generation->stage;
+				chrono::steady_clock::duration expectedDuration =
+						generation->step == 0 ? lastDuration : generation->stepDurations[stage];
+				if (advanced && stepStart - start + expectedDuration > limit)
+				{
+					return false;
+				}
+
+				bool complete = !advance(*generation);
+				lastDuration = chrono::steady_clock::now() - stepStart;
+				generation->stepDurations[stage] = lastDuration;
+				advanced = true;
+
+				if (complete)
+				{
+					generation.reset();
+				}
+			}
+
+			return true;
+		}
+
+		unique_ptr<Entity> createChunk(Generation& generation, unsigned int x, unsigned int z)
+		{
+			const Settings& settings = generation.settings;
+			const vector<vector<float>>& heightMap = generation.heightMap;
+			unsigned int chunkSize = generation.chunkSize;
+			unsigned int index = generation.chunks.size();
+
+			unique_ptr<Entity> chunk(new Entity(EntityCategories::GROUND));
+			generation.foliageCandidates.push_back(ArenaVector<FoliagePlacement::Candidate>(generation.arena));
+
+			// Chunks entirely beneath the cutoff are not rendered but can still be collided with.
+			if (generation.cutoff && getMaxHeight(heightMap, x, z, chunkSize) < generation.cutoffHeight)
+			{
+				if (!settings.underwaterCollision)
+				{
+					return nullptr;
+				}
+
+				if (!generation.triangulatable)
+				{
+					chunk->addUniqueComponent(createHeightMapBody(heightMap, x, z, chunkSize, chunk->getTransform()));
+				}
+
+				return move(chunk);
+			}
+
+			// Chunk mesh:
+			MeshData& terrainData = generation.terrainStaging.stage(pow(chunkSize, 2) * 6, 0);
+			if (generation.adaptiveTerrain)
+			{
+				insertAdaptiveVertices(heightMap, generation.errorMap, x, z, chunkSize, settings.terrainTolerance,
+						generation.triangles, terrainData);
+			}
+			else
+			{
+				insertHeightMapVertices(heightMap, x, z, chunkSize, terrainData);
+			}
 
-		vector<Triangle> grassPositions;
-		vector<Vector3> rockPositions;
-		vector<Vector3> treePositions;
+			unsigned int cliffBudget = 0;
+			if (settings.cliffTriangleBudget > 0)
+			{
+				float cliffShare = 0.0f;
+				if (generation.totalCliffWeight > 0.0f)
+				{
+					cliffShare = generation.cliffWeights[index] / generation.totalCliffWeight;
+				}
+				cliffBudget = max(1.0f, settings.cliffTriangleBudget * cliffShare);
+			}
 
-		void addDetail(MeshData& meshData, unsigned int vertexIndex)
-		{
-			Vector3 up(0.0, 1.0, 0.0);
-			Vector3 center = (meshData[vertexIndex].position + meshData[vertexIndex + 1].position +
-					meshData[vertexIndex + 2].position) / 3.0f;
-			float maxY = max(meshData[vertexIndex].position.Y(), max(meshData[vertexIndex + 1].position.Y(),
-					meshData[vertexIndex + 2].position.Y()));
+			MeshData& meshData = addDetail(generation, terrainData,
+					generation.removeSubmergedTerrain ? generation.cutoffHeight : -FLT_MAX, cliffBudget);
 
-			// Rocks!
-			/////////////////////////
-			if (maxY > 0.0f && getRandomBool(0.025f))
+			if (generation.removeSubmergedTerrain)
 			{
-				rockPositions.push_back(center);
+				removeSubmerged(meshData, generation.cutoffHeight);
 			}
 
-			// Cliffs!
-			if (fabs(dotProduct(meshData[vertexIndex].normal, up)) < 0.2f)
+			if (settings.bakeLighting)
 			{
-				meshData[vertexIndex].color = Vector4(0.6f, 0.6f, 0.6f, 1.0f);
-				meshData[vertexIndex + 1].color = Vector4(0.6f, 0.6f, 0.6f, 1.0f);
-				meshData[vertexIndex + 2].color = Vector4(0.6f, 0.6f, 0.6f, 1.0f);
+				applyLighting(meshData, generation.lightMap);
+			}
 
-				divideTriangle(meshData, vertexIndex, CLIFF_SUBDIVIDE_MAX_DEPTH);
+			chunk->addUniqueComponent(ModelFunctions::getSquareBoundsXZ(meshData.vertexData, meshData.vertexCount));
 
-				return;
+			if (settings.checksums)
+			{
+				islandChecksums.chunks[index] = Checksums::hashVertices(meshData, settings.checksumTolerance);
+				islandChecksums.biomeColors = Checksums::hashColors(meshData, settings.checksumTolerance,
+						islandChecksums.biomeColors);
+			}
+
+			// Chunks with more colors than fit in a palette (baked lighting multiplies them) keep a full mesh.
+			if (settings.compactTerrain && CompactMesh::fitsPalette(meshData))
+			{
+				// Chunks that cannot be simplified collide with their height map.
+				if (!generation.triangulatable)
+				{
+					chunk->addUniqueComponent(createHeightMapBody(heightMap, x, z, chunkSize, chunk->getTransform()));
+				}
+
+				chunk->addUniqueComponent(unique_ptr<CompactMesh>(new CompactMesh(meshData)));
+				generation.terrainStaging.unstage();
+			}
+			else
+			{
+				generation.stagedChunks.push_back(index);
 			}
 
-			// Snow!
-			if (maxY > 20.0f)
+			return move(chunk);
+		}
+
+		bool createChunks(Generation& generation, unsigned int step)
+		{
+			unsigned int chunksPerEdge = (generation.edgeLength - 1) / generation.chunkSize;
+			unsigned int x = step / chunksPerEdge * generation.chunkSize;
+			unsigned int z = step % chunksPerEdge * generation.chunkSize;
+
+			if (generation.triangulatable && !generation.threaded)
 			{
-				meshData[vertexIndex].color = Vector4(0.9f, 0.9f, 0.9f, 1.0f);
-				meshData[vertexIndex + 1].color = Vector4(0.9f, 0.9f, 0.9f, 1.0f);
-				meshData[vertexIndex + 2].color = Vector4(0.9f, 0.9f, 0.9f, 1.0f);
+				generation.collisionChunks.push_back(createCollisionChunk(generation.heightMap, generation.errorMap, x,
+						z, generation.chunkSize, generation.settings.collisionTolerance,
+						generation.collisionCutoffHeight, generation.triangles));
+			}
 
-				smoothen(meshData, vertexIndex);
+			generation.chunks.push_back(createChunk(generation, x, z));
 
-				return;
+			return generation.chunks.size() == generation.chunkCount;
+		}
+
+		bool createCollisionBodies(Generation& generation, unsigned int step)
+		{
+			if (!generation.triangulatable)
+			{
+				return true;
+			}
+
+			vector<CollisionChunk>& collisionChunks = generation.collisionChunks;
+			if (step == 0)
+			{
+				if (generation.threaded)
+				{
+					collisionChunks = generation.futureCollisionChunks.get();
+				}
+
+				unsigned int collisionVertexCount = 0;
+				unsigned int collisionIndexCount = 0;
+				for (const CollisionChunk& collisionChunk : collisionChunks)
+				{
+					collisionVertexCount += collisionChunk.vertices.size();
+					collisionIndexCount += collisionChunk.indices.size();
+				}
+
+				generation.collisionBuffer =
+						ModelFactory::getInstance()->createMeshBuffer(collisionVertexCount, collisionIndexCount,
+								Buffer::AccessHint::READ);
 			}
 
-			// Beaches!
-			if ((fabs(dotProduct(meshData[vertexIndex].normal, up)) > 0.5f && maxY < 0.5f) ||
-					maxY < 0.0f)
+			// One chunk at a time.
+			vector<unique_ptr<Entity>>& chunks = generation.chunks;
+			if (step < chunks.size() && chunks[step] != nullptr && !collisionChunks[step].indices.empty())
 			{
-				meshData[vertexIndex].color = Vector4(0.83f, 0.65f, 0.15f, 1.0f);
-				meshData[vertexIndex + 1].color = Vector4(0.83f, 0.65f, 0.15f, 1.0f);
-				meshData[vertexIndex + 2].color = Vector4(0.83f, 0.65f, 0.15f, 1.0f);
+				unique_ptr<Mesh> collisionMesh = createCollisionMesh(collisionChunks[step], generation.collisionBuffer);
 
-				smoothen(meshData, vertexIndex);
+				unique_ptr<Body> body = PhysicsFactory::getInstance()->createBody(getStaticMaterial(),
+						collisionMesh.get(), chunks[step]->getTransform(), false);
+				chunks[step]->addUniqueComponent(move(body));
 
-				return;
+				collisionMeshes.push_back(move(collisionMesh));
 			}
 
-			// Grass!
-			grassPositions.push_back(Triangle(meshData[vertexIndex].position, meshData[vertexIndex + 1].position,
-					meshData[vertexIndex + 2].position));
+			if (step + 1 < chunks.size())
+			{
+				return false;
+			}
+
+			collisionChunks.clear();
+			generation.collisionBuffer.reset();
+
+			return true;
+		}
+
+		CollisionChunk createCollisionChunk(const vector<vector<float>>& heightMap, const ArenaMap& errorMap,
+				unsigned int minX, unsigned int minZ, unsigned int chunkSize, float tolerance, float cutoffHeight,
+				ArenaVector<TerrainTriangulator::GridPoint>& triangles)
+		{
+			triangles.clear();
+			TerrainTriangulator::triangulate(errorMap, minX, minZ, chunkSize, tolerance, triangles);
+
+			// Share the vertices between the triangles.
+			CollisionChunk collisionChunk;
+			collisionChunk.indices.reserve(triangles.size());
+			ArenaVector<unsigned int> vertexIndices(pow(chunkSize + 1, 2), UINT_MAX, triangles.get_allocator());
 
-			// Trees!
-			if (getRandomBool(0.025f))
+			for (unsigned int index = 0; index < triangles.size(); index++)
 			{
-				Vector3 up(0.0f, 1.0f, 0.0f);
+				const TerrainTriangulator::GridPoint& point = triangles[index];
 
-				if (dotProduct(center, up) > 0.8f)
+				// Skip whole triangles beneath the cutoff.
+				if (index % 3 == 0 &&
+						heightMap[point.x][point.z] < cutoffHeight &&
+						heightMap[triangles[index + 1].x][triangles[index + 1].z] < cutoffHeight &&
+						heightMap[triangles[index + 2].x][triangles[index + 2].z] < cutoffHeight)
 				{
-					center.Y() -= 0.1f;
+					index += 2;
+					continue;
+				}
 
-					treePositions.push_back(center);
+				unsigned int& vertexIndex = vertexIndices[(point.x - minX) * (chunkSize + 1) + point.z - minZ];
+				if (vertexIndex == UINT_MAX)
+				{
+					vertexIndex = collisionChunk.vertices.size();
+					collisionChunk.vertices.push_back(HeightMapFunctions::getPosition(heightMap, point.x, point.z));
 				}
+
+				collisionChunk.indices.push_back(vertexIndex);
 			}
 
-			smoothen(meshData, vertexIndex);
+			return collisionChunk;
 		}
 
-		void addFoliage()
+		vector<CollisionChunk> createCollisionChunks(const vector<vector<float>>& heightMap, const ArenaMap& errorMap,
+				unsigned int chunkSize, float tolerance, float cutoffHeight)
 		{
-			unsigned int foliageVertexCount = //GRASS_BLADE_COUNT * 3 * grassPositions.size() +
-					pow(ROCK_DETAIL + 1, 2) * 4 * rockPositions.size();
-			unsigned int foliageIndexCount = //GRASS_BLADE_COUNT * 6 * grassPositions.size() +
-					pow(ROCK_DETAIL, 2) * 6 * rockPositions.size();
-			shared_ptr<MeshBuffer> foliageBuffer =
-					ModelFactory::getInstance()->createMeshBuffer(foliageVertexCount, foliageIndexCount);
+			unsigned int edgeLength = heightMap.size();
+
+			// This runs on a thread of its own so it cannot share the arena of the generation.
+			Arena arena;
+			ArenaVector<TerrainTriangulator::GridPoint> triangles(arena);
 
-			/*for (Triangle& grassPosition : grassPositions)
+			vector<CollisionChunk> collisionChunks;
+			collisionChunks.reserve(pow((edgeLength - 1) / chunkSize, 2));
+
+			for (unsigned int x = 0; x < edgeLength - 1; x += chunkSize)
 			{
-				growGrass(grassPosition, foliageBuffer);
-			}*/
-			grassPositions.clear();
+				for (unsigned int z = 0; z < edgeLength - 1; z += chunkSize)
+				{
+					collisionChunks.push_back(createCollisionChunk(heightMap, errorMap, x, z, chunkSize, tolerance,
+							cutoffHeight, triangles));
+				}
+			}
+
+			return collisionChunks;
+		}
+
+		unique_ptr<Mesh> createCollisionMesh(const CollisionChunk& collisionChunk, shared_ptr<MeshBuffer> buffer)
+		{
+			unique_ptr<Mesh> mesh(new Mesh(buffer));
+			MeshData& meshData = mesh->getData(false);
 
-			for (Vector3& rockPosition : rockPositions)
+			meshData.vertexCount = collisionChunk.vertices.size();
+			for (unsigned int index = 0; index < meshData.vertexCount; index++)
 			{
-				RockFactory::createRock(rockPosition, foliageBuffer, getRandomFloat(0.25f, 0.75f), ROCK_DETAIL);
+				meshData[index].position = collisionChunk.vertices[index];
 			}
-			rockPositions.clear();
 
-			// TODO Include trees in foliage buffer?
-			for (Vector3& treePosition : treePositions)
+			meshData.indexCount = collisionChunk.indices.size();
+			memcpy(meshData.indexData, collisionChunk.indices.data(), meshData.indexCount * sizeof(unsigned int));
+
+			mesh->releaseData();
+
+			return move(mesh);
+		}
+
+		void createIsland(unsigned int radius, const vector<float>& profile, unsigned int chunkSize,
+				const Settings& settings)
+		{
+			startIsland(radius, profile, chunkSize, settings, true);
+			while (advance(*generation))
 			{
-				TreeFactory::createTree(treePosition);
 			}
-			treePositions.clear();
+
+			generation.reset();
 		}
 
-		unsigned int adjustIndex(unsigned int index, int adjustment, string adjustmentAxis, string axis, int direction)
+		void createFoliageBody(const ArenaVector<CollisionProxy>& proxies, shared_ptr<MeshBuffer> buffer,
+				SceneBatch& batch)
 		{
-			if (adjustmentAxis == axis)
+			if (proxies.empty())
 			{
-				return index - direction;
+				return;
 			}
-			else
+
+			unique_ptr<Mesh> mesh(new Mesh(buffer));
+			MeshData& meshData = mesh->getData(false);
+			meshData.vertexCount = 0;
+			meshData.indexCount = 0;
+
+			for (const CollisionProxy& proxy : proxies)
 			{
-				return index + adjustment;
+				insertProxy(meshData, proxy);
 			}
+
+			mesh->releaseData();
+
+			unique_ptr<Entity> foliage(new Entity(EntityCategories::FOLIAGE_COLLISION));
+			unique_ptr<Body> body = PhysicsFactory::getInstance()->createBody(getStaticMaterial(), mesh.get(),
+					foliage->getTransform(), false);
+			foliage->addUniqueComponent(move(body));
+			batch.add(move(foliage));
+
+			collisionMeshes.push_back(move(mesh));
 		}
 
-		void createIsland(unsigned int radius, const vector<float>& profile, unsigned int chunkSize)
+		unique_ptr<Body> createHeightMapBody(const vector<vector<float>>& heightMap, unsigned int minX,
+				unsigned int minZ, unsigned int chunkSize, const Matrix44& transform)
 		{
-			unsigned int edgeLength = radius * 2 + 1;
-			unsigned int chunkCount = pow((edgeLength - 1) / chunkSize, 2);
+			unique_ptr<Mesh> mesh = ModelFactory::getInstance()->createHeightMapMesh(heightMap, minX,
+					minX + chunkSize, minZ, minZ + chunkSize, shared_ptr<MeshBuffer>(),
+					Vector4(0.0f, 0.5f, 0.0f, 1.0f));
+			unique_ptr<Body> body =
+					PhysicsFactory::getInstance()->createBody(getStaticMaterial(), mesh.get(), transform, false);
 
-			// The Island!
-			/////////////////////////
-			vector<vector<float>> heightMap;
-			vector<vector<float>> slopeMap;
-			initializeMaps(heightMap, slopeMap, edgeLength);
+			collisionMeshes.push_back(move(mesh));
 
-			heightMap[radius][radius] = profile[0];
+			return move(body);
+		}
 
-			fillHeightMapSector(radius, profile, heightMap, slopeMap, "x", -1);
-			fillHeightMapSector(radius, profile, heightMap, slopeMap, "x", 1);
-			fillHeightMapSector(radius, profile, heightMap, slopeMap, "z", -1);
-			fillHeightMapSector(radius, profile, heightMap, slopeMap, "z", 1);
+		bool decodeHeights(Generation& generation, unsigned int step)
+		{
+			const Settings& settings = generation.settings;
+			unsigned int edgeLength = generation.edgeLength;
 
-			shared_ptr<MeshBuffer> buffer = ModelFactory::getInstance()->createMeshBuffer(
-					pow(chunkSize, 2) * 6 * 10 * chunkCount, 0, Buffer::AccessHint::READ);
+			// The island is built from the decoded heights whether they were cached or not so that both give the
+			// same terrain. They are decoded one row at a time.
+			if (step == 0)
+			{
+				generation.heightMap.assign(edgeLength, vector<float>(edgeLength));
 
-			for (unsigned int x = 0; x < edgeLength - 1; x += chunkSize)
+				islandChecksums = Checksums::IslandChecksums();
+				if (settings.checksums)
+				{
+					islandChecksums.heightMap = Checksums::hashInteger(edgeLength);
+					islandChecksums.chunks.assign(generation.chunkCount, Checksums::EMPTY);
+				}
+			}
+
+			vector<float>& row = generation.heightMap[step];
+			islandHeightMap.decodeRow(step, row.data());
+
+			if (settings.checksums)
 			{
-				for (unsigned int z = 0; z < edgeLength - 1; z += chunkSize)
+				islandChecksums.heightMap = Checksums::hashHeights(row.data(), row.size(), settings.checksumTolerance,
+						islandChecksums.heightMap);
+			}
+
+			return step == edgeLength - 1;
+		}
+
+		void divideCliffs(MeshData& meshData, const ArenaVector<CliffTriangle>& cliffs)
+		{
+			// The divided triangles are written after the rest of the mesh.
+			unsigned int outputIndex = meshData.vertexCount;
+			for (const CliffTriangle& cliff : cliffs)
+			{
+				meshData.vertexCount += (pow(3, cliff.depth) - 1) * 3;
+			}
+
+			Vertex levels[2][CLIFF_SUBDIVIDE_MAX_TRIANGLES * 3];
+			for (const CliffTriangle& cliff : cliffs)
+			{
+				if (cliff.depth == 0)
+				{
+					continue;
+				}
+
+				// Divide one level at a time, each level's triangles stored contiguously.
+				memcpy(levels[0], &meshData[cliff.vertexIndex], sizeof(Vertex) * 3);
+				unsigned int triangleCount = 1;
+				unsigned int current = 0;
+
+				for (unsigned int depth = 0; depth < cliff.depth; depth++)
 				{
-					unique_ptr<Entity> chunk(new Entity(EntityCategories::GROUND));
+					for (unsigned int triangle = 0; triangle < triangleCount; triangle++)
+					{
+						divideTriangle(&levels[current][triangle * 3], &levels[1 - current][triangle * 9]);
+					}
+
+					triangleCount *= 3;
+					current = 1 - current;
+				}
+
+				// The first triangle replaces the cliff, the rest are written after each other.
+				memcpy(&meshData[cliff.vertexIndex], levels[current], sizeof(Vertex) * 3);
+				memcpy(&meshData[outputIndex], &levels[current][3], sizeof(Vertex) * (triangleCount - 1) * 3);
+				outputIndex += (triangleCount - 1) * 3;
+			}
+		}
+
+		void divideTriangle(const Vertex* triangle, Vertex* dividedTriangles)
+		{
+			Vector3 center = (triangle[0].position + triangle[1].position + triangle[2].position) / 3.0f;
+
+			Vector3 divideCenter = center;
+			divideCenter += (triangle[0].position - center) * 0.5f * getRandomFloat(0.0f, 1.0f);
+			divideCenter += (triangle[1].position - center) * 0.5f * getRandomFloat(0.0f, 1.0f);
+			divideCenter += (triangle[2].position - center) * 0.5f * getRandomFloat(0.0f, 1.0f);
+			divideCenter += triangle[0].normal * getRandomFloat(-0.1f, 0.1f);
+
+			Vector4 color = triangle[0].color;
+			Vector3 point0 = triangle[0].position;
+			Vector3 point1 = triangle[1].position;
+			Vector3 point2 = triangle[2].position;
+
+			const Vector3 corners[3][2] = { { point0, point1 }, { point1, point2 }, { point2, point0 } };
+			for (unsigned int index = 0; index < 3; index++)
+			{
+				Vertex* dividedTriangle = &dividedTriangles[index * 3];
+
+				dividedTriangle[0].color = color;
+				dividedTriangle[0].position = divideCenter;
+				dividedTriangle[1].color = color;
+				dividedTriangle[1].position = corners[index][0];
+				dividedTriangle[2].color = color;
+				dividedTriangle[2].position = corners[index][1];
+
+				Vector3 edge0 = dividedTriangle[1].position - dividedTriangle[0].position;
+				Vector3 edge1 = dividedTriangle[2].position - dividedTriangle[0].position;
+				Vector3 normal = crossProduct(edge0, edge1);
+				dividedTriangle[0].normal = normal;
+				dividedTriangle[1].normal = normal;
+				dividedTriangle[2].normal = normal;
+			}
+		}
+
+		bool erodeHeights(Generation& generation, unsigned int step)
+		{
+			const Erosion::Settings& erosion = generation.settings.erosion;
+
+			// Eroding the height map gives the terrain its detail before it is meshed, leaving fewer cliffs to
+			// subdivide.
+			if (generation.cached || !generation.settings.erodeHeights || erosion.iterations == 0)
+			{
+				return true;
+			}
+
+			if (generation.threaded)
+			{
+				Erosion::erode(generation.generatedHeights.data(), generation.edgeLength, erosion);
+
+				return true;
+			}
+
+			// One tile with one kind of erosion at a time.
+			if (step == 0)
+			{
+				generation.thermalHeights.assign(generation.generatedHeights.size(), 0.0f);
+				generation.erosionTiles.resize(Erosion::getIterationStepCount(generation.edgeLength) / 2);
+				Erosion::getTileOrder(generation.edgeLength, generation.erosionTiles.data());
+			}
+
+			chrono::steady_clock::time_point start = chrono::steady_clock::now();
+			Erosion::erodeStep(generation.generatedHeights.data(), generation.thermalHeights.data(),
+					generation.erosionTiles.data(), generation.edgeLength, erosion, step);
+			generation.erosionDuration += chrono::steady_clock::now() - start;
+
+			// Iterations are never cut short.
+			unsigned int iterationStepCount = Erosion::getIterationStepCount(generation.edgeLength);
+			if ((step + 1) % iterationStepCount != 0)
+			{
+				return false;
+			}
 
-					// Chunk mesh:
-					unique_ptr<Mesh> mesh = ModelFactory::getInstance()->createHeightMapMesh(heightMap, x,
-							x + chunkSize, z, z + chunkSize, buffer, Vector4(0.0f, 0.5f, 0.0f, 1.0f));
+			chrono::duration<float> elapsed = generation.erosionDuration;
+			if (step + 1 < erosion.iterations * iterationStepCount &&
+					(erosion.timeBudget <= 0.0f || elapsed.count() < erosion.timeBudget))
+			{
+				return false;
+			}
 
-					// Full mesh:
-					//unique_ptr<Mesh> mesh = ModelFactory::getInstance()->createHeightMapMesh(heightMap, 0,
-					//		edgeLength - 1, 0, edgeLength - 1, buffer, Vector4(0.0f, 0.5f, 0.0f, 1.0f));
+			generation.erosionTiles.clear();
+			generation.thermalHeights.clear();
 
-					MeshData& meshData = mesh->getData(true);
+			return true;
+		}
 
-					unsigned int initialVertexCount = meshData.vertexCount;
-					for (unsigned int vertexIndex = 0; vertexIndex < initialVertexCount; vertexIndex += 3)
+		void fillHeightMapRing(unsigned int radius, unsigned int currentRadius, const ArenaVector<float>& radialProfile,
+				ArenaMap& heightMap, ArenaMap& slopeMap, const string& axis, int direction, mt19937& random)
+		{
+			unsigned int beginIndexX = 0;
+			unsigned int endIndexX = 0;
+			unsigned int beginIndexZ = 0;
+			unsigned int endIndexZ = 0;
+			getTraversalIndices(radius, currentRadius, axis, direction, beginIndexX, endIndexX, beginIndexZ,
+					endIndexZ);
+
+			for (unsigned int x = beginIndexX; x <= endIndexX; x++)
+			{
+				for (unsigned int z = beginIndexZ; z <= endIndexZ; z++)
+				{
+					float heightFactor = 0.0f;
+					float slopeFactor = 0.0f;
+					if (axis == "x")
+					{
+						getFactors(x, z, heightMap, slopeMap, axis, direction, beginIndexZ, endIndexZ, heightFactor,
+								slopeFactor);
+					}
+					else if (axis == "z")
 					{
-						addDetail(meshData, vertexIndex);
+						getFactors(x, z, heightMap, slopeMap, axis, direction, beginIndexX, endIndexX, heightFactor,
+															slopeFactor);
 					}
 
-					unique_ptr<Model> bounds =
-						ModelFunctions::getSquareBoundsXZ(meshData.vertexData, meshData.vertexCount);
+					setHeight(radius, radialProfile, x, z, heightMap, slopeMap, heightFactor, random);
+				}
+			}
+		}
+
+		bool generateHeights(Generation& generation, unsigned int step)
+		{
+			if (generation.cached)
+			{
+				return true;
+			}
 
-					mesh->releaseData();
+			unsigned int edgeLength = generation.edgeLength;
+			unsigned int radius = generation.radius;
 
-					Body::Material material;
-					material.mass = 0.0f;
-					material.friction = 0.5f;
-					material.restitution = 0.5f;
-					unique_ptr<Body> body = PhysicsFactory::getInstance()->createBody(material, mesh.get(),
-							chunk->getTransform(), false);
+			if (generation.settings.noiseHeights)
+			{
+				if (generation.threaded)
+				{
+					generateNoiseHeightMap(edgeLength, generation.profile, generation.settings.heightNoise,
+							generation.generatedHeights);
 
-					chunk->addUniqueComponent(move(mesh));
-					chunk->addUniqueComponent(move(bounds));
-					chunk->addUniqueComponent(move(body));
+					return true;
+				}
 
-					Simplicity::getScene()->addEntity(move(chunk));
+				// One row at a time.
+				if (step == 0)
+				{
+					generation.generatedHeights.assign(edgeLength * edgeLength, 0.0f);
 				}
+
+				HeightNoise::generateTile(generation.profile, edgeLength, step, 0, step + 1, edgeLength,
+						generation.settings.heightNoise, generation.generatedHeights.data() + step * edgeLength,
+						edgeLength);
+
+				return step == edgeLength - 1;
 			}
 
-			addFoliage();
+			// The heights are propagated out from the center one ring of one sector at a time.
+			if (step == 0)
+			{
+				initializeMaps(generation.generatedHeightMap, generation.slopeMap, edgeLength);
+				generation.generatedHeightMap[radius][radius] = generation.profile[0];
+				generation.radialProfile = getRadialProfile(radius, generation.profile, generation.arena);
+				generation.random.seed(generation.heightSeed);
 
-			// The Sky!
-			/////////////////////////
-			unique_ptr<Entity> sky(new Entity);
-			rotate(sky->getTransform(), MathConstants::PI * -0.5f, Vector3(1.0f, 0.0f, 0.0f));
+				return false;
+			}
 
-			unique_ptr<Mesh> skyMesh = ModelFactory::getInstance()->createHemisphereMesh(1100.0f, 20,
-					shared_ptr<MeshBuffer>(), Vector4(0.0f, 0.5f, 0.75f, 1.0f), true);
+			unsigned int ring = step - 1;
+			if (ring < radius * 4)
+			{
+				unsigned int sector = ring / radius;
+				fillHeightMapRing(radius, ring % radius + 1, generation.radialProfile, generation.generatedHeightMap,
+						generation.slopeMap, sector < 2 ? "x" : "z", sector % 2 == 0 ? -1 : 1, generation.random);
 
-			sky->addUniqueComponent(move(skyMesh));
-			Simplicity::getScene()->addEntity(move(sky));
+				return false;
+			}
 
-			// The Ocean!
-			/////////////////////////
-			unique_ptr<Entity> ocean(new Entity);
-			rotate(ocean->getTransform(), MathConstants::PI * -0.5f, Vector3(1.0f, 0.0f, 0.0f));
+			generation.generatedHeights.reserve(edgeLength * edgeLength);
+			for (const ArenaVector<float>& row : generation.generatedHeightMap)
+			{
+				generation.generatedHeights.insert(generation.generatedHeights.end(), row.begin(), row.end());
+			}
 
-			unique_ptr<Mesh> oceanMesh =
-					ModelFactory::getInstance()->createCylinderMesh(1200.0f, 500.0f, 20, shared_ptr<MeshBuffer>(),
-							Vector4(0.0f, 0.4f, 0.6f, 1.0f), true);
+			return true;
+		}
 
-			ocean->addUniqueComponent(move(oceanMesh));
-			Simplicity::getScene()->addEntity(move(ocean));
+		void generateNoiseHeightMap(unsigned int edgeLength, const vector<float>& profile,
+				const HeightNoise::Settings& settings, ArenaVector<float>& heights)
+		{
+			heights.assign(edgeLength * edgeLength, 0.0f);
+			HeightNoise::generate(profile, edgeLength, settings, heights.data());
 		}
 
-		void divideTriangle(MeshData& meshData, unsigned int vertexIndex, unsigned int maxDepth, unsigned int depth)
+		uint64_t getCacheKey(const Generation& generation)
 		{
-			Vector3 center = (meshData[vertexIndex].position + meshData[vertexIndex + 1].position +
-					meshData[vertexIndex + 2].position) / 3.0f;
+			const Settings& settings = generation.settings;
 
-			Vector3 divideCenter = center;
-			divideCenter += (meshData[vertexIndex].position - center) * 0.5f * getRandomFloat(0.0f, 1.0f);
-			divideCenter += (meshData[vertexIndex + 1].position - center) * 0.5f * getRandomFloat(0.0f, 1.0f);
-			divideCenter += (meshData[vertexIndex + 2].position - center) * 0.5f * getRandomFloat(0.0f, 1.0f);
-			divideCenter += meshData[vertexIndex].normal * getRandomFloat(-0.1f, 0.1f);
-
-			Vertex triangle0[3];
-			triangle0[0].color = meshData[vertexIndex].color;
-			triangle0[0].position = divideCenter;
-			triangle0[1].color = meshData[vertexIndex].color;
-			triangle0[1].position = meshData[vertexIndex].position;
-			triangle0[2].color = meshData[vertexIndex].color;
-			triangle0[2].position = meshData[vertexIndex + 1].position;
-
-			Vector3 edge0 = triangle0[1].position - triangle0[0].position;
-			Vector3 edge1 = triangle0[2].position - triangle0[0].position;
-			Vector3 normal = crossProduct(edge0, edge1);
-			triangle0[0].normal = normal;
-			triangle0[1].normal = normal;
-			triangle0[2].normal = normal;
-
-			Vertex triangle1[3];
-			triangle1[0].color = meshData[vertexIndex].color;
-			triangle1[0].position = divideCenter;
-			triangle1[1].color = meshData[vertexIndex].color;
-			triangle1[1].position = meshData[vertexIndex + 1].position;
-			triangle1[2].color = meshData[vertexIndex].color;
-			triangle1[2].position = meshData[vertexIndex + 2].position;
-
-			edge0 = triangle1[1].position - triangle1[0].position;
-			edge1 = triangle1[2].position - triangle1[0].position;
-			normal = crossProduct(edge0, edge1);
-			triangle1[0].normal = normal;
-			triangle1[1].normal = normal;
-			triangle1[2].normal = normal;
-
-			Vertex triangle2[3];
-			triangle2[0].color = meshData[vertexIndex].color;
-			triangle2[0].position = divideCenter;
-			triangle2[1].color = meshData[vertexIndex].color;
-			triangle2[1].position = meshData[vertexIndex + 2].position;
-			triangle2[2].color = meshData[vertexIndex].color;
-			triangle2[2].position = meshData[vertexIndex].position;
-
-			edge0 = triangle2[1].position - triangle2[0].position;
-			edge1 = triangle2[2].position - triangle2[0].position;
-			normal = crossProduct(edge0, edge1);
-			triangle2[0].normal = normal;
-			triangle2[1].normal = normal;
-			triangle2[2].normal = normal;
-
-			meshData.vertexCount += 6;
-
-			memcpy(&meshData[vertexIndex], triangle0, sizeof(triangle0));
-			memcpy(&meshData[meshData.vertexCount - 6], triangle1, sizeof(triangle1));
-			memcpy(&meshData[meshData.vertexCount - 3], triangle2, sizeof(triangle2));
-
-			if (depth < maxDepth)
-			{
-				// The vertex count will be modified by the following recursive calls so save it here.
-				unsigned int vertexCount = meshData.vertexCount;
-
-				divideTriangle(meshData, vertexIndex, maxDepth, depth + 1);
-				divideTriangle(meshData, vertexCount - 6, maxDepth, depth + 1);
-				divideTriangle(meshData, vertexCount - 3, maxDepth, depth + 1);
-			}
-		}
-
-		void fillHeightMapSector(unsigned int radius, const vector<float>& profile, vector<vector<float>>& heightMap,
-				vector<vector<float>>& slopeMap, string axis, int direction)
-		{
-			for (unsigned int currentRadius = 1; currentRadius <= radius; currentRadius++)
-			{
-				unsigned int beginIndexX = 0;
-				unsigned int endIndexX = 0;
-				unsigned int beginIndexZ = 0;
-				unsigned int endIndexZ = 0;
-				getTraversalIndices(radius, currentRadius, axis, direction, beginIndexX, endIndexX, beginIndexZ,
-						endIndexZ);
-
-				for (unsigned int x = beginIndexX; x <= endIndexX; x++)
-				{
-					for (unsigned int z = beginIndexZ; z <= endIndexZ; z++)
-					{
-						float heightFactor = 0.0f;
-						float slopeFactor = 0.0f;
-						if (axis == "x")
-						{
-							getFactors(x, z, heightMap, slopeMap, axis, direction, beginIndexZ, endIndexZ, heightFactor,
-									slopeFactor);
-						}
-						else if (axis == "z")
-						{
-							getFactors(x, z, heightMap, slopeMap, axis, direction, beginIndexX, endIndexX, heightFactor,
-																slopeFactor);
-						}
+			uint64_t key = Checksums::hashInteger(generation.edgeLength);
+			key = Checksums::hashInteger(generation.heightSeed, key);
+			for (float height : generation.profile)
+			{
+				key = Checksums::hashValue(height, 0.0f, key);
+			}
 
-						setHeight(radius, profile, x, z, heightMap, slopeMap, heightFactor);
-					}
+			key = Checksums::hashInteger(settings.noiseHeights, key);
+			if (settings.noiseHeights)
+			{
+				const HeightNoise::Settings& noise = settings.heightNoise;
+				for (float value : { noise.amplitude, noise.frequency, noise.lacunarity, noise.persistence })
+				{
+					key = Checksums::hashValue(value, 0.0f, key);
+				}
+				key = Checksums::hashInteger(noise.octaves, key);
+				key = Checksums::hashInteger(noise.seed, key);
+			}
+
+			key = Checksums::hashInteger(settings.erodeHeights, key);
+			if (settings.erodeHeights)
+			{
+				const Erosion::Settings& erosion = settings.erosion;
+				for (float value : { erosion.capacity, erosion.depositionRate, erosion.dropletDensity,
+						erosion.erosionRate, erosion.evaporationRate, erosion.inertia, erosion.talus,
+						erosion.thermalRate, erosion.timeBudget })
+				{
+					key = Checksums::hashValue(value, 0.0f, key);
 				}
+				key = Checksums::hashInteger(erosion.dropletLifetime, key);
+				key = Checksums::hashInteger(erosion.iterations, key);
+				key = Checksums::hashInteger(erosion.seed, key);
 			}
+
+			return key;
+		}
+
+		const Checksums::IslandChecksums& getChecksums()
+		{
+			return islandChecksums;
 		}
 
-		float getAdjusted(const vector<vector<float>>& source, unsigned int x, unsigned int z, int adjustment,
-				string axis, int direction)
+		float getAdjusted(const ArenaMap& source, unsigned int x, unsigned int z, int adjustment,
+				const string& axis, int direction)
 		{
 			return source[adjustIndex(x, adjustment, "x", axis, direction)]
 			              [adjustIndex(z, adjustment, "z", axis, direction)];
 		}
 
-		void getFactors(unsigned int x, unsigned int z, const vector<vector<float>>& heightMap,
-				const vector<vector<float>>& slopeMap, string axis, int direction, unsigned int beginIndex,
+		void getFactors(unsigned int x, unsigned int z, const ArenaMap& heightMap, const ArenaMap& slopeMap,
+				const string& axis, int direction, unsigned int beginIndex,
 				unsigned int endIndex, float& heightFactor, float& slopeFactor)
 		{
 			unsigned int traversalIndex = 0;
@@ -397,39 +1550,121 @@ namespace theisland
 			}
 			else if (traversalIndex == beginIndex + 1)
 			{
-				heightFactor =
-						getAdjusted(heightMap, x, z, 0, axis, direction) +
-						getAdjusted(heightMap, x, z, 1, axis, direction);
-				heightFactor /= 2.0f;
-				slopeFactor =
-						getAdjusted(slopeMap, x, z, 0, axis, direction) +
-						getAdjusted(slopeMap, x, z, 1, axis, direction);
-				slopeFactor /= 2.0f;
+				heightFactor =
+						getAdjusted(heightMap, x, z, 0, axis, direction) +
+						getAdjusted(heightMap, x, z, 1, axis, direction);
+				heightFactor /= 2.0f;
+				slopeFactor =
+						getAdjusted(slopeMap, x, z, 0, axis, direction) +
+						getAdjusted(slopeMap, x, z, 1, axis, direction);
+				slopeFactor /= 2.0f;
+			}
+			else if (traversalIndex == endIndex - 1)
+			{
+				heightFactor =
+						getAdjusted(heightMap, x, z, -1, axis, direction) +
+						getAdjusted(heightMap, x, z, 0, axis, direction);
+				heightFactor /= 2.0f;
+				slopeFactor =
+						getAdjusted(slopeMap, x, z, -1, axis, direction) +
+						getAdjusted(slopeMap, x, z, 0, axis, direction);
+				slopeFactor /= 2.0f;
+			}
+			else
+			{
+				heightFactor =
+						getAdjusted(heightMap, x, z, -1, axis, direction) +
+						getAdjusted(heightMap, x, z, 0, axis, direction) +
+						getAdjusted(heightMap, x, z, 1, axis, direction);
+				heightFactor /= 3.0f;
+				slopeFactor =
+						getAdjusted(slopeMap, x, z, -1, axis, direction) +
+						getAdjusted(slopeMap, x, z, 0, axis, direction) +
+						getAdjusted(slopeMap, x, z, 1, axis, direction);
+				slopeFactor /= 3.0f;
+			}
+		}
+
+		float getHeight(const Vector3& position)
+		{
+			float x;
+			float z;
+			HeightMapFunctions::getCoordinates(islandHeightMap.getEdgeLength(), position, x, z);
+
+			return islandHeightMap.getHeight(x, z);
+		}
+
+		const QuantizedHeightMap& getHeightMap()
+		{
+			return islandHeightMap;
+		}
+
+		float getMaxHeight(const vector<vector<float>>& heightMap, unsigned int minX, unsigned int minZ,
+				unsigned int chunkSize)
+		{
+			float maxHeight = -FLT_MAX;
+			for (unsigned int x = minX; x <= minX + chunkSize; x++)
+			{
+				for (unsigned int z = minZ; z <= minZ + chunkSize; z++)
+				{
+					maxHeight = max(maxHeight, heightMap[x][z]);
+				}
+			}
+
+			return maxHeight;
+		}
+
+		const NavigationGrid& getNavigationGrid()
+		{
+			return navigationGrid;
+		}
+
+		OceanClipmap* getOcean()
+		{
+			return oceanClipmap.get();
+		}
+
+		unsigned int getProxyIndexCount(const CollisionProxy& proxy)
+		{
+			// Spheres are octahedrons, capsules are prisms.
+			if (proxy.height == 0.0f)
+			{
+				return 8 * 3;
 			}
-			else if (traversalIndex == endIndex - 1)
+
+			return PROXY_SIDES * 4 * 3;
+		}
+
+		unsigned int getProxyVertexCount(const CollisionProxy& proxy)
+		{
+			if (proxy.height == 0.0f)
 			{
-				heightFactor =
-						getAdjusted(heightMap, x, z, -1, axis, direction) +
-						getAdjusted(heightMap, x, z, 0, axis, direction);
-				heightFactor /= 2.0f;
-				slopeFactor =
-						getAdjusted(slopeMap, x, z, -1, axis, direction) +
-						getAdjusted(slopeMap, x, z, 0, axis, direction);
-				slopeFactor /= 2.0f;
+				return 6;
 			}
-			else
+
+			return PROXY_SIDES * 2 + 2;
+		}
+
+		ArenaVector<float> getRadialProfile(unsigned int radius, const vector<float>& profile, Arena& arena)
+		{
+			// The height of the profile at every squared distance from the center of the island an offset can have.
+			// The distance only grows by one when the squared distance reaches the square of the next distance so no
+			// square roots are needed.
+			unsigned int maxSquaredDistance = radius * radius * 2;
+			ArenaVector<float> radialProfile(maxSquaredDistance + 1, 0.0f, arena);
+
+			unsigned int distance = 0;
+			for (unsigned int squaredDistance = 0; squaredDistance <= maxSquaredDistance; squaredDistance++)
 			{
-				heightFactor =
-						getAdjusted(heightMap, x, z, -1, axis, direction) +
-						getAdjusted(heightMap, x, z, 0, axis, direction) +
-						getAdjusted(heightMap, x, z, 1, axis, direction);
-				heightFactor /= 3.0f;
-				slopeFactor =
-						getAdjusted(slopeMap, x, z, -1, axis, direction) +
-						getAdjusted(slopeMap, x, z, 0, axis, direction) +
-						getAdjusted(slopeMap, x, z, 1, axis, direction);
-				slopeFactor /= 3.0f;
+				if ((distance + 1) * (distance + 1) <= squaredDistance)
+				{
+					distance++;
+				}
+
+				radialProfile[squaredDistance] = profile[distance];
 			}
+
+			return radialProfile;
 		}
 
 		Vector3 getSmoothNormal(MeshData& meshData, unsigned int x, unsigned int z)
@@ -519,7 +1754,7 @@ namespace theisland
 			return normal;
 		}
 
-		void getTraversalIndices(unsigned int radius, unsigned int currentRadius, string axis, int direction,
+		void getTraversalIndices(unsigned int radius, unsigned int currentRadius, const string& axis, int direction,
 				unsigned int& beginIndexX, unsigned int& endIndexX, unsigned int& beginIndexZ, unsigned int& endIndexZ)
 		{
 			unsigned int beginIndex = radius - currentRadius;
@@ -560,96 +1795,557 @@ namespace theisland
 			}
 		}
 
-		void growGrass(const Triangle& ground, shared_ptr<MeshBuffer> buffer)
+		Body::Material getStaticMaterial()
 		{
-			unique_ptr<Entity> grass(new Entity);
+			Body::Material material;
+			material.mass = 0.0f;
+			material.friction = 0.5f;
+			material.restitution = 0.5f;
 
-			float averageBladeHeight = 0.5f;
-			unsigned int vertexCount = GRASS_BLADE_COUNT * 3;
-			unsigned int indexCount = GRASS_BLADE_COUNT * 6;
+			return material;
+		}
 
-			unique_ptr<Mesh> mesh(new Mesh(buffer));
-			MeshData& grassData = mesh->getData(false);
-			grassData.vertexCount = vertexCount;
-			grassData.indexCount = indexCount;
+		void groupProxies(const vector<vector<float>>& heightMap, unsigned int chunkSize,
+				const ArenaVector<CollisionProxy>& proxies, ArenaVector<ArenaVector<CollisionProxy>>& chunkProxies)
+		{
+			unsigned int chunksPerEdge = (heightMap.size() - 1) / chunkSize;
+
+			// Each chunk only needs one body for all the foliage standing in it.
+			chunkProxies.assign(chunksPerEdge * chunksPerEdge,
+					ArenaVector<CollisionProxy>(chunkProxies.get_allocator()));
+			for (const CollisionProxy& proxy : proxies)
+			{
+				unsigned int x = 0;
+				unsigned int z = 0;
+				HeightMapFunctions::getCoordinates(heightMap, proxy.position, x, z);
+
+				unsigned int chunkX = min(x / chunkSize, chunksPerEdge - 1);
+				unsigned int chunkZ = min(z / chunkSize, chunksPerEdge - 1);
+				chunkProxies[chunkX * chunksPerEdge + chunkZ].push_back(proxy);
+			}
+		}
+
+		void initializeMaps(ArenaMap& heightMap, ArenaMap& slopeMap, unsigned int edgeLength)
+		{
+			heightMap.reserve(edgeLength);
+			slopeMap.reserve(edgeLength);
+			for (unsigned int x = 0; x < edgeLength; x++)
+			{
+				heightMap.push_back(ArenaVector<float>(edgeLength, 0.0f, heightMap.get_allocator()));
+				slopeMap.push_back(ArenaVector<float>(edgeLength, 0.0f, slopeMap.get_allocator()));
+			}
+		}
+
+		void insertAdaptiveVertices(const vector<vector<float>>& heightMap, const ArenaMap& errorMap,
+				unsigned int minX, unsigned int minZ, unsigned int chunkSize, float tolerance,
+				ArenaVector<TerrainTriangulator::GridPoint>& triangles, MeshData& meshData)
+		{
+			triangles.clear();
+			TerrainTriangulator::triangulate(errorMap, minX, minZ, chunkSize, tolerance, triangles);
+
+			meshData.vertexCount = triangles.size();
+
+			for (unsigned int vertexIndex = 0; vertexIndex < meshData.vertexCount; vertexIndex += 3)
+			{
+				Vector3 point0 = HeightMapFunctions::getPosition(heightMap, triangles[vertexIndex].x,
+						triangles[vertexIndex].z);
+				Vector3 point1 = HeightMapFunctions::getPosition(heightMap, triangles[vertexIndex + 1].x,
+						triangles[vertexIndex + 1].z);
+				Vector3 point2 = HeightMapFunctions::getPosition(heightMap, triangles[vertexIndex + 2].x,
+						triangles[vertexIndex + 2].z);
+
+				ModelFactory::insertTriangleVertices(meshData.vertexData, vertexIndex, point0, point1 - point0,
+						point2 - point0, Vector4(0.0f, 0.5f, 0.0f, 1.0f));
+
+				// Detailing relies on the normals being normalized face normals.
+				Vector3 normal = crossProduct(point1 - point0, point2 - point0);
+				normal.normalize();
+				meshData[vertexIndex].normal = normal;
+				meshData[vertexIndex + 1].normal = normal;
+				meshData[vertexIndex + 2].normal = normal;
+			}
+		}
+
+		void insertHeightMapVertices(const vector<vector<float>>& heightMap, unsigned int minX, unsigned int minZ,
+				unsigned int chunkSize, MeshData& meshData)
+		{
+			meshData.vertexCount = chunkSize * chunkSize * 6;
+
+			// The same layout as the engine's height map meshes (which smoothing relies on): two triangles per cell
+			// with the cells in rows along z.
+			unsigned int vertexIndex = 0;
+			for (unsigned int x = minX; x < minX + chunkSize; x++)
+			{
+				for (unsigned int z = minZ; z < minZ + chunkSize; z++)
+				{
+					Vector3 point0 = HeightMapFunctions::getPosition(heightMap, x, z);
+					Vector3 point1 = HeightMapFunctions::getPosition(heightMap, x, z + 1);
+					Vector3 point2 = HeightMapFunctions::getPosition(heightMap, x + 1, z + 1);
+					Vector3 point3 = HeightMapFunctions::getPosition(heightMap, x + 1, z);
+
+					const Vector3 triangles[2][3] = { { point0, point1, point2 }, { point0, point2, point3 } };
+					for (const Vector3* triangle : triangles)
+					{
+						Vector3 normal = crossProduct(triangle[1] - triangle[0], triangle[2] - triangle[0]);
+						normal.normalize();
+
+						for (unsigned int corner = 0; corner < 3; corner++)
+						{
+							meshData[vertexIndex].color = Vector4(0.0f, 0.5f, 0.0f, 1.0f);
+							meshData[vertexIndex].normal = normal;
+							meshData[vertexIndex].position = triangle[corner];
+							vertexIndex++;
+						}
+					}
+				}
+			}
+		}
+
+		void insertProxy(MeshData& meshData, const CollisionProxy& proxy)
+		{
+			unsigned int vertexOffset = meshData.vertexCount;
+			unsigned int* indices = meshData.indexData + meshData.indexCount;
+
+			meshData.vertexCount += getProxyVertexCount(proxy);
+			meshData.indexCount += getProxyIndexCount(proxy);
 
-			Vector3 center = (ground.getPointA() + ground.getPointB() + ground.getPointC()) / 3.0f;
+			if (proxy.height == 0.0f)
+			{
+				meshData[vertexOffset].position = proxy.position + Vector3(proxy.radius, 0.0f, 0.0f);
+				meshData[vertexOffset + 1].position = proxy.position + Vector3(0.0f, 0.0f, proxy.radius);
+				meshData[vertexOffset + 2].position = proxy.position + Vector3(-proxy.radius, 0.0f, 0.0f);
+				meshData[vertexOffset + 3].position = proxy.position + Vector3(0.0f, 0.0f, -proxy.radius);
+				meshData[vertexOffset + 4].position = proxy.position + Vector3(0.0f, proxy.radius, 0.0f);
+				meshData[vertexOffset + 5].position = proxy.position + Vector3(0.0f, -proxy.radius, 0.0f);
+
+				for (unsigned int side = 0; side < 4; side++)
+				{
+					unsigned int next = (side + 1) % 4;
+
+					*indices++ = vertexOffset + side;
+					*indices++ = vertexOffset + next;
+					*indices++ = vertexOffset + 4;
+
+					*indices++ = vertexOffset + next;
+					*indices++ = vertexOffset + side;
+					*indices++ = vertexOffset + 5;
+				}
+
+				return;
+			}
 
-			for (unsigned int blade = 0; blade < GRASS_BLADE_COUNT; blade++)
+			unsigned int top = vertexOffset + PROXY_SIDES * 2;
+			unsigned int bottom = top + 1;
+			meshData[top].position = proxy.position + Vector3(0.0f, proxy.height, 0.0f);
+			meshData[bottom].position = proxy.position;
+
+			for (unsigned int side = 0; side < PROXY_SIDES; side++)
 			{
-				Vector3 grassPosition = center;
+				float angle = MathConstants::PI * 2.0f * side / PROXY_SIDES;
+				Vector3 offset(sin(angle) * proxy.radius, 0.0f, cos(angle) * proxy.radius);
+
+				meshData[vertexOffset + side * 2].position = proxy.position + offset;
+				meshData[vertexOffset + side * 2 + 1].position = proxy.position + offset +
+						Vector3(0.0f, proxy.height, 0.0f);
 
-				Vector3 toPointA = ground.getPointA() - grassPosition;
-				grassPosition += toPointA * getRandomFloat(0.0f, 1.0f);
-				Vector3 toPointB = ground.getPointB() - grassPosition;
-				grassPosition += toPointB * getRandomFloat(0.0f, 1.0f);
-				Vector3 toPointC = ground.getPointC() - grassPosition;
-				grassPosition += toPointC * getRandomFloat(0.0f, 1.0f);
+				unsigned int lower = vertexOffset + side * 2;
+				unsigned int upper = lower + 1;
+				unsigned int nextLower = vertexOffset + ((side + 1) % PROXY_SIDES) * 2;
+				unsigned int nextUpper = nextLower + 1;
 
-				float saturation = getRandomFloat(0.25f, 0.75f);
-				float height = getRandomFloat(0.5f, 1.5f) * averageBladeHeight;
-				float angle = getRandomFloat(0.0f, 1.0f);
+				*indices++ = lower;
+				*indices++ = nextLower;
+				*indices++ = upper;
 
-				ModelFactory::insertTriangleVertices(grassData.vertexData, blade * 3,
-						grassPosition + Vector3(0.0f, height, 0.0f),
-						Vector3(sin(angle) * height * 0.1f, -height, cos(angle) * height * 0.1f),
-						Vector3(-sin(angle) * height * 0.1f, -height, -cos(angle) * height * 0.1f),
-						Vector4(0.0f, saturation, 0.0f, 1.0f));
+				*indices++ = upper;
+				*indices++ = nextLower;
+				*indices++ = nextUpper;
 
-				ModelFactory::insertTriangleIndices(grassData.indexData, blade * 6, blade * 3);
-				ModelFactory::insertTriangleIndices(grassData.indexData, blade * 6 + 3, blade * 3, true);
+				*indices++ = upper;
+				*indices++ = nextUpper;
+				*indices++ = top;
+
+				*indices++ = nextLower;
+				*indices++ = lower;
+				*indices++ = bottom;
 			}
+		}
 
-			unique_ptr<Model> bounds = ModelFunctions::getCircleBoundsXZ(grassData.vertexData, grassData.vertexCount);
+		bool isSubmerged(const MeshData& meshData, unsigned int vertexIndex, float cutoffHeight)
+		{
+			return meshData[vertexIndex].position.Y() < cutoffHeight &&
+					meshData[vertexIndex + 1].position.Y() < cutoffHeight &&
+					meshData[vertexIndex + 2].position.Y() < cutoffHeight;
+		}
 
-			mesh->releaseData();
+		bool loadHeightMap(const string& path, uint64_t key, unsigned int edgeLength,
+				QuantizedHeightMap& quantizedHeightMap)
+		{
+			ifstream cache(path, ios::binary);
+			uint64_t cacheKey = 0;
+			cache.read(reinterpret_cast<char*>(&cacheKey), sizeof(cacheKey));
+
+			// Height maps of other islands are not used.
+			QuantizedHeightMap cachedHeightMap;
+			if (!cache || cacheKey != key || !cachedHeightMap.load(cache) ||
+					cachedHeightMap.getEdgeLength() != edgeLength)
+			{
+				return false;
+			}
 
-			grass->addUniqueComponent(move(mesh));
-			grass->addUniqueComponent(move(bounds));
+			quantizedHeightMap = move(cachedHeightMap);
 
-			Simplicity::getScene()->addEntity(move(grass));
+			return true;
 		}
 
-		void initializeMaps(vector<vector<float>>& heightMap, vector<vector<float>>& slopeMap, unsigned int edgeLength)
+		bool loadHeights(Generation& generation, unsigned int)
 		{
-			heightMap.reserve(edgeLength);
-			slopeMap.reserve(edgeLength);
-			for (unsigned int x = 0; x < edgeLength; x++)
+			// The seeds are drawn whether or not the heights are loaded (or the seeds are set) so that the rest of the
+			// island gets the same random numbers either way.
+			generation.heightSeed = getRandomInt(0, INT_MAX);
+			unsigned int heightNoiseSeed = getRandomInt(0, INT_MAX);
+			unsigned int erosionSeed = getRandomInt(0, INT_MAX);
+
+			if (generation.settings.heightNoise.seed == 0)
+			{
+				generation.settings.heightNoise.seed = heightNoiseSeed;
+			}
+
+			if (generation.settings.erosion.seed == 0)
+			{
+				generation.settings.erosion.seed = erosionSeed;
+			}
+			generation.cacheKey = getCacheKey(generation);
+
+			generation.cached = !generation.settings.heightMapCache.empty() &&
+					loadHeightMap(generation.settings.heightMapCache, generation.cacheKey, generation.edgeLength,
+							islandHeightMap);
+
+			return true;
+		}
+
+		bool placeFoliage(Generation& generation, unsigned int step)
+		{
+			const Settings& settings = generation.settings;
+			unsigned int edgeLength = generation.edgeLength;
+			unsigned int chunkSize = generation.chunkSize;
+			unsigned int chunksPerEdge = (edgeLength - 1) / chunkSize;
+			float halfEdgeLength = static_cast<float>(edgeLength / 2);
+
+			FoliagePlacement::Settings& placementSettings = generation.foliageSettings;
+			if (step == 0)
+			{
+				placementSettings.density = settings.foliageDensity;
+				placementSettings.rockSpacing = settings.rockSpacing;
+				placementSettings.seed = getRandomInt(0, INT_MAX);
+				placementSettings.treeSpacing = settings.treeSpacing;
+			}
+
+			ArenaVector<ArenaVector<FoliagePlacement::Candidate>>& candidates = generation.foliageCandidates;
+			ArenaVector<Vector3>& rockPositions = generation.rockPositions;
+			ArenaVector<Vector3>& treePositions = generation.treePositions;
+			if (generation.threaded)
+			{
+				FoliagePlacement::place(candidates, chunksPerEdge, chunkSize, -halfEdgeLength, -halfEdgeLength,
+						placementSettings, rockPositions, treePositions);
+			}
+			else
+			{
+				// One chunk at a time.
+				if (step == 0)
+				{
+					generation.foliageHash = FoliagePlacement::createHash(chunksPerEdge, chunkSize, -halfEdgeLength,
+							-halfEdgeLength, placementSettings);
+					FoliagePlacement::getChunkOrder(chunksPerEdge, generation.foliageOrder);
+				}
+
+				if (step < candidates.size())
+				{
+					FoliagePlacement::placeChunk(candidates, generation.foliageOrder[step], placementSettings,
+							*generation.foliageHash, rockPositions, treePositions);
+				}
+
+				if (step + 1 < candidates.size())
+				{
+					return false;
+				}
+
+				generation.foliageHash.reset();
+				generation.foliageOrder.clear();
+			}
+
+			if (settings.checksums)
+			{
+				islandChecksums.rocks = Checksums::hashInstances(rockPositions.data(), rockPositions.size(),
+						settings.checksumTolerance);
+				islandChecksums.trees = Checksums::hashInstances(treePositions.data(), treePositions.size(),
+						settings.checksumTolerance);
+			}
+
+			return true;
+		}
+
+		unsigned int planCliffs(const MeshData& meshData, const ArenaVector<unsigned int>& cliffIndices,
+				unsigned int budget, ArenaVector<CliffTriangle>& cliffs)
+		{
+			Vector3 up(0.0f, 1.0f, 0.0f);
+
+			cliffs.clear();
+			cliffs.reserve(cliffIndices.size());
+
+			// The steeper the cliff, the deeper it is subdivided.
+			for (unsigned int vertexIndex : cliffIndices)
+			{
+				Vector3 edge0 = meshData[vertexIndex + 1].position - meshData[vertexIndex].position;
+				Vector3 edge1 = meshData[vertexIndex + 2].position - meshData[vertexIndex].position;
+				Vector3 normal = crossProduct(edge0, edge1);
+				float area = normal.getMagnitude() / 2.0f;
+				float flatness = fabs(dotProduct(meshData[vertexIndex].normal, up));
+
+				CliffTriangle cliff;
+				cliff.vertexIndex = vertexIndex;
+				cliff.depth = max(1u, min(CLIFF_SUBDIVIDE_MAX_DEPTH,
+						static_cast<unsigned int>(ceil(CLIFF_SUBDIVIDE_MAX_DEPTH * (0.2f - flatness) / 0.2f))));
+				cliff.priority = area * (1.0f - flatness);
+
+				cliffs.push_back(cliff);
+			}
+
+			// Over budget, the most prominent cliffs keep their depth and the rest get what is left.
+			if (budget > 0)
+			{
+				sort(cliffs.begin(), cliffs.end(), [](const CliffTriangle& a, const CliffTriangle& b)
+				{
+					return a.priority > b.priority;
+				});
+
+				unsigned int extraBudget = budget > cliffs.size() ? budget - cliffs.size() : 0;
+				for (CliffTriangle& cliff : cliffs)
+				{
+					while (cliff.depth > 0 && pow(3, cliff.depth) - 1 > extraBudget)
+					{
+						cliff.depth--;
+					}
+
+					extraBudget -= pow(3, cliff.depth) - 1;
+				}
+			}
+
+			unsigned int vertexCount = 0;
+			for (const CliffTriangle& cliff : cliffs)
+			{
+				vertexCount += (pow(3, cliff.depth) - 1) * 3;
+			}
+
+			return vertexCount;
+		}
+
+		bool prepareChunks(Generation& generation, unsigned int step)
+		{
+			const Settings& settings = generation.settings;
+			unsigned int chunksPerEdge = (generation.edgeLength - 1) / generation.chunkSize;
+
+			if (step == 0)
+			{
+				generation.triangulatable = TerrainTriangulator::isAdaptive(generation.chunkSize);
+
+				generation.cutoff = settings.oceanCutoffDepth > 0.0f;
+				generation.cutoffHeight = generation.cutoff ? -settings.oceanCutoffDepth : -FLT_MAX;
+				generation.collisionCutoffHeight =
+						settings.underwaterCollision ? -FLT_MAX : generation.cutoffHeight;
+
+				// Chunks that collide with their render mesh have to keep the submerged terrain if it is to be
+				// collided with.
+				generation.removeSubmergedTerrain =
+						generation.cutoff && (generation.triangulatable || !settings.underwaterCollision);
+
+				generation.adaptiveTerrain = generation.triangulatable && settings.adaptiveTerrain;
+
+				if (settings.cliffTriangleBudget > 0)
+				{
+					generation.cliffWeights.assign(generation.chunkCount, 0.0f);
+				}
+
+				generation.chunks.reserve(generation.chunkCount);
+			}
+
+			// The errors are calculated a level of a row of chunks at a time...
+			unsigned int errorStepCount = 0;
+			if (generation.triangulatable)
+			{
+				errorStepCount = TerrainTriangulator::getErrorStepCount(generation.edgeLength, generation.chunkSize);
+			}
+
+			if (step < errorStepCount)
+			{
+				TerrainTriangulator::calculateErrorStep(generation.heightMap, generation.chunkSize, step,
+						generation.errorMap);
+
+				return false;
+			}
+
+			// ... and then the cliff budget is shared out between the chunks by how much cliff they are expected to
+			// have a row of chunks at a time.
+			unsigned int chunkX = step - errorStepCount;
+			if (settings.cliffTriangleBudget > 0 && chunkX < chunksPerEdge)
+			{
+				addCliffWeights(generation.heightMap, generation.chunkSize, chunkX, generation.cliffWeights);
+			}
+
+			if (chunkX + 1 < chunksPerEdge)
+			{
+				return false;
+			}
+
+			for (float cliffWeight : generation.cliffWeights)
+			{
+				generation.totalCliffWeight += cliffWeight;
+			}
+
+			// The collision meshes only need the height map so they are built while the chunks are being detailed
+			// (or with each chunk if no threads can be spared).
+			if (generation.triangulatable && generation.threaded)
+			{
+				generation.futureCollisionChunks = async(launch::async, createCollisionChunks,
+						cref(generation.heightMap), cref(generation.errorMap), generation.chunkSize,
+						settings.collisionTolerance, generation.collisionCutoffHeight);
+			}
+
+			return true;
+		}
+
+		bool quantizeHeights(Generation& generation, unsigned int step)
+		{
+			if (generation.cached)
+			{
+				return true;
+			}
+
+			unsigned int edgeLength = generation.edgeLength;
+
+			// The range of the heights is found one row at a time...
+			if (step < edgeLength)
+			{
+				const float* row = generation.generatedHeights.data() + step * edgeLength;
+				generation.generatedMinHeight = min(generation.generatedMinHeight, *min_element(row, row + edgeLength));
+				generation.generatedMaxHeight = max(generation.generatedMaxHeight, *max_element(row, row + edgeLength));
+
+				if (step == edgeLength - 1)
+				{
+					islandHeightMap = QuantizedHeightMap(edgeLength, generation.generatedMinHeight,
+							generation.generatedMaxHeight);
+				}
+
+				return false;
+			}
+
+			// ... and then they are encoded one row at a time.
+			unsigned int x = step - edgeLength;
+			islandHeightMap.encodeRow(x, generation.generatedHeights.data() + x * edgeLength);
+			if (x < edgeLength - 1)
+			{
+				return false;
+			}
+
+			if (!generation.settings.heightMapCache.empty())
+			{
+				saveHeightMap(generation.settings.heightMapCache, generation.cacheKey, islandHeightMap);
+			}
+
+			generation.generatedHeightMap.clear();
+			generation.generatedHeights.clear();
+			generation.radialProfile.clear();
+			generation.slopeMap.clear();
+
+			return true;
+		}
+
+		void removeIsland()
+		{
+			// An island that is still being created is abandoned.
+			generation.reset();
+
+			// The bodies go with the entities so the meshes they collide with can only be freed once the entities have
+			// been removed.
+			Scene* scene = Simplicity::getScene();
+			for (Entity* entity : islandEntities)
+			{
+				scene->removeEntity(*entity);
+			}
+			islandEntities.clear();
+
+			collisionMeshes.clear();
+			EntityCategories::clearEntities();
+			TreeFactory::getImpostorLod().clear();
+		}
+
+		void removeSubmerged(MeshData& meshData, float cutoffHeight)
+		{
+			unsigned int keptVertexCount = 0;
+			for (unsigned int vertexIndex = 0; vertexIndex < meshData.vertexCount; vertexIndex += 3)
 			{
-				heightMap.push_back(vector<float>());
-				heightMap[x].reserve(edgeLength);
-				slopeMap.push_back(vector<float>());
-				slopeMap[x].reserve(edgeLength);
+				if (isSubmerged(meshData, vertexIndex, cutoffHeight))
+				{
+					continue;
+				}
 
-				for (unsigned int z = 0; z < edgeLength; z++)
+				if (keptVertexCount != vertexIndex)
 				{
-					heightMap[x].push_back(0.0f);
-					slopeMap[x].push_back(0.0f);
+					memcpy(&meshData[keptVertexCount], &meshData[vertexIndex], sizeof(Vertex) * 3);
 				}
+
+				keptVertexCount += 3;
 			}
+
+			meshData.vertexCount = keptVertexCount;
+		}
+
+		void saveHeightMap(const string& path, uint64_t key, const QuantizedHeightMap& quantizedHeightMap)
+		{
+			ofstream cache(path, ios::binary);
+			cache.write(reinterpret_cast<const char*>(&key), sizeof(key));
+			quantizedHeightMap.save(cache);
 		}
 
-		void setHeight(unsigned int radius, const vector<float>& profile, unsigned int x, unsigned int z,
-				vector<vector<float>>& heightMap, vector<vector<float>>& slopeMap, float heightFactor)
+		void setHeight(unsigned int radius, const ArenaVector<float>& radialProfile, unsigned int x, unsigned int z,
+				ArenaMap& heightMap, ArenaMap& slopeMap, float heightFactor, mt19937& random)
 		{
-			if (getRandomBool(0.8f))
+			uniform_real_distribution<float> unit(0.0f, 1.0f);
+			if (unit(random) < 0.8f)
 			{
 				heightMap[x][z] = heightFactor;// + slopeFactor;
 			}
 			else
 			{
-				float distance = floor(sqrt(pow(fabs((float) radius - x), 2) + pow(fabs((float) radius - z), 2)));
-				heightMap[x][z] = profile[static_cast<unsigned int>(distance)];
+				unsigned int offsetX = x > radius ? x - radius : radius - x;
+				unsigned int offsetZ = z > radius ? z - radius : radius - z;
+				heightMap[x][z] = radialProfile[offsetX * offsetX + offsetZ * offsetZ];
 			}
 
-			float randomization = getRandomFloat(-0.1f, 0.1f);
+			float randomization = uniform_real_distribution<float>(-0.1f, 0.1f)(random);
 			heightMap[x][z] += randomization;
 
 			slopeMap[x][z] = heightMap[x][z] - heightFactor;
 		}
 
-		void smoothen(MeshData& meshData, unsigned int vertexIndex)
+		void smoothen(MeshData& meshData, unsigned int vertexIndex, const vector<vector<float>>& heightMap,
+				bool adaptive)
 		{
+			// Adaptive meshes are not laid out in a grid so their normals come from the height map instead.
+			if (adaptive)
+			{
+				for (unsigned int index = vertexIndex; index < vertexIndex + 3; index++)
+				{
+					unsigned int x = 0;
+					unsigned int z = 0;
+					HeightMapFunctions::getCoordinates(heightMap, meshData[index].position, x, z);
+
+					meshData[index].normal = HeightMapFunctions::getNormal(heightMap, x, z);
+				}
+
+				return;
+			}
+
 			unsigned int gridElement = vertexIndex / 6;
 			unsigned int edgeLength = static_cast<unsigned int>(sqrt(meshData.vertexCount / 6));
 
@@ -669,5 +2365,68 @@ namespace theisland
 				meshData[vertexIndex + 2].normal = getSmoothNormal(meshData, x + 1, z);
 			}
 		}
+
+		void startIsland(unsigned int radius, const vector<float>& profile, unsigned int chunkSize,
+				const Settings& settings, bool threaded)
+		{
+			removeIsland();
+
+			TreeFactory::getImpostorLod().setDistances(settings.impostorDistance, settings.impostorFadeDistance);
+
+			// Nothing allocated from the arena for the last island is still alive once it has been removed.
+			islandArena.release();
+			generation.reset(new Generation(islandArena));
+			generation->chunkCount = pow(radius * 2 / chunkSize, 2);
+			generation->chunkSize = chunkSize;
+			generation->edgeLength = radius * 2 + 1;
+			generation->profile = profile;
+			generation->radius = radius;
+			generation->settings = settings;
+			if (settings.erodeHeights && settings.erosion.timeBudget > 0.0f)
+			{
+				// How far the erosion gets depends on how fast the machine is so there is nothing to compare.
+				generation->settings.checksums = false;
+			}
+			generation->stepDurations.assign(STAGE_COUNT, chrono::steady_clock::duration::zero());
+			generation->threaded = threaded;
+		}
+
+		bool uploadTerrain(Generation& generation, unsigned int step)
+		{
+			StagingBuffer& terrainStaging = generation.terrainStaging;
+
+			// One chunk at a time.
+			if (step < terrainStaging.getMeshCount())
+			{
+				if (step == 0)
+				{
+					// Chunks that cannot be simplified collide with their render mesh so it has to be readable.
+					generation.terrainBuffer = terrainStaging.createBuffer(Buffer::AccessHint::READ);
+				}
+
+				Entity& chunk = *generation.chunks[generation.stagedChunks[step]];
+				unique_ptr<Mesh> terrainMesh = terrainStaging.upload(step, generation.terrainBuffer);
+
+				// Chunks that cannot be simplified collide with their render mesh.
+				if (!generation.triangulatable)
+				{
+					unique_ptr<Body> body = PhysicsFactory::getInstance()->createBody(getStaticMaterial(),
+							terrainMesh.get(), chunk.getTransform(), false);
+					chunk.addUniqueComponent(move(body));
+				}
+
+				chunk.addUniqueComponent(move(terrainMesh));
+			}
+
+			if (step + 1 < terrainStaging.getMeshCount())
+			{
+				return false;
+			}
+
+			terrainStaging.clear();
+			generation.terrainBuffer.reset();
+
+			return true;
+		}
 	}
 }
@@ -21,11 +21,145 @@
 
 #include <simplicity/API.h>
 
+#include "Checksums.h"
+#include "Erosion.h"
+#include "HeightNoise.h"
+#include "NavigationGrid.h"
+#include "OceanClipmap.h"
+#include "QuantizedHeightMap.h"
+#include "TerrainLighting.h"
+
 namespace theisland
 {
 	namespace IslandFactory
 	{
-		SIMPLE_API void createIsland(unsigned int radius, const std::vector<float>& profile, unsigned int chunkSize = 16);
+		struct SIMPLE_API Settings
+		{
+			// The maximum height error allowed when simplifying the collision meshes of the chunks.
+			float collisionTolerance = 0.25f;
+
+			// Triangulates the terrain adaptively instead of with two triangles per height map cell so that flat
+			// areas use far fewer triangles (only when the chunk size is a power of two).
+			bool adaptiveTerrain = false;
+
+			// The maximum height error allowed when triangulating the terrain adaptively.
+			float terrainTolerance = 0.2f;
+
+			// Terrain this far beneath the ocean surface is neither detailed nor rendered and chunks entirely beneath
+			// it are not created (0 disables the cutoff).
+			float oceanCutoffDepth = 0.0f;
+
+			// Keeps the collision meshes of the terrain beneath the ocean cutoff.
+			bool underwaterCollision = true;
+
+			// The most triangles the cliffs of the whole island may be subdivided into (0 for no limit). The steepest
+			// and largest cliffs are given the most detail.
+			unsigned int cliffTriangleBudget = 0;
+
+			// Gives the chunks a CompactMesh instead of a Mesh, for hosts that render terrain themselves. The chunks
+			// are detailed in memory so no terrain mesh buffer is created, unless a chunk has more colors than fit in
+			// the palette of a CompactMesh in which case it is given a Mesh as usual.
+			bool compactTerrain = false;
+
+			// A file the height map is loaded from if it holds the height map of an island with the same size,
+			// profile, seed (of the engine's random numbers) and height settings, and saved to otherwise (none if
+			// empty). The rest of the island is the same whether its heights were loaded or not.
+			std::string heightMapCache;
+
+			// Generates the heights from the profile plus noise, in parallel, instead of propagating them ring by ring
+			// from the center.
+			bool noiseHeights = false;
+
+			// The noise added to the profile when generating the heights from noise. Its seed is taken from the
+			// engine's random numbers unless it is set.
+			HeightNoise::Settings heightNoise;
+
+			// Erodes the generated height map before the terrain is built from it.
+			bool erodeHeights = false;
+
+			// How the height map is eroded. Its seed is taken from the engine's random numbers unless it is set.
+			Erosion::Settings erosion;
+
+			// Darkens the colors of the terrain with ambient occlusion and sun shadows baked from the height map.
+			bool bakeLighting = false;
+
+			// How the lighting of the terrain is baked.
+			TerrainLighting::Settings lighting;
+
+			// Makes the ocean a grid of rings around the camera with waves instead of a flat cylinder. The host calls
+			// update on it (see getOcean) every frame.
+			bool clipmapOcean = false;
+
+			// Records checksums of the island as it is built (see getChecksums). Ignored when the height map is eroded
+			// with a time budget, which makes the heights depend on the speed of the machine.
+			bool checksums = false;
+
+			// The step the values are snapped to before they are hashed (0 hashes the exact values). The checksums
+			// only ever match exactly, see Checksums.
+			float checksumTolerance = 0.001f;
+
+			// Builds a grid of walking costs and a graph of the ways between the chunks (see getNavigationGrid).
+			bool buildNavigation = false;
+
+			// How walkable the terrain is.
+			NavigationGrid::Settings navigation;
+
+			// Scales how much foliage grows in every biome.
+			float foliageDensity = 1.0f;
+
+			// The minimum distance between rocks. Rocks and trees are kept apart by the average of the two spacings.
+			float rockSpacing = 2.0f;
+
+			// The minimum distance between trees.
+			float treeSpacing = 3.0f;
+
+			// The distance from the camera at which trees are swapped for their impostors (0 disables impostors).
+			float impostorDistance = 0.0f;
+
+			// The width of the band around the impostor distance in which trees and impostors are cross-faded.
+			float impostorFadeDistance = 20.0f;
+		};
+
+		// Starts creating an island a step at a time (see continueIsland) for hosts that cannot stall for as long as
+		// createIsland takes. Each step does a tile, row, chunk or batch of work on this thread, apart from reading and
+		// writing the height map cache which are done in one go. Once it is complete the island is added to the scene
+		// a slice of its entities at a time. The island is the same as createIsland would create. An island that is
+		// still being created is abandoned and the last island is removed (see removeIsland).
+		SIMPLE_API void beginIsland(unsigned int radius, const std::vector<float>& profile,
+				unsigned int chunkSize = 16, const Settings& settings = Settings());
+
+		// Creates more of the island begun with beginIsland, stopping before a step that is not expected to fit in
+		// what is left of the budget (in microseconds). A step is expected to take as long as the last step of its
+		// stage, or as the last step taken if it is the first step of its stage. At least one step is always taken.
+		// Returns true once the island is complete and has been added to the scene (or if no island was begun).
+		SIMPLE_API bool continueIsland(unsigned int budget);
+
+		// Removes the last island first (see removeIsland).
+		SIMPLE_API void createIsland(unsigned int radius, const std::vector<float>& profile,
+				unsigned int chunkSize = 16, const Settings& settings = Settings());
+
+		// Checksums of the last island created (if it was created with checksums). Two islands built from the same
+		// seed (of the engine's random numbers) and settings should have the same checksums whichever way they were
+		// built.
+		SIMPLE_API const Checksums::IslandChecksums& getChecksums();
+
+		// Interpolates the height of the last island created beneath a position.
+		SIMPLE_API float getHeight(const simplicity::Vector3& position);
+
+		// The height map of the last island created.
+		SIMPLE_API const QuantizedHeightMap& getHeightMap();
+
+		// The navigation grid of the last island created (empty if it was created without navigation). Its chunks
+		// are in the same order as the chunk entities.
+		SIMPLE_API const NavigationGrid& getNavigationGrid();
+
+		// The ocean of the last island created if it is a clipmap ocean (null otherwise).
+		SIMPLE_API OceanClipmap* getOcean();
+
+		// Removes the entities of the last island from the scene and then frees the meshes their bodies collide
+		// with. Hosts remove islands with this rather than removing their entities from the scene themselves. An
+		// island that is still being created is abandoned.
+		SIMPLE_API void removeIsland();
 	}
 }
 
@@ -0,0 +1,665 @@
+/*
+ * Copyright © 2014 Simple Entertainment Limited
+ *
+ * This file is part of The Island.
+ *
+ * The Island is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * The Island is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with The Island. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <algorithm>
+#include <cfloat>
+#include <climits>
+#include <cmath>
+#include <functional>
+#include <future>
+#include <queue>
+#include <thread>
+
+#include "Biomes.h"
+#include "HeightMapFunctions.h"
+#include "NavigationGrid.h"
+
+using namespace simplicity;
+using namespace std;
+
+static const float DIAGONAL_LENGTH = 1.41421356f;
+
+namespace theisland
+{
+	typedef pair<float, unsigned int> QueueEntry;
+	typedef priority_queue<QueueEntry, vector<QueueEntry>, greater<QueueEntry>> Queue;
+
+	void forEachChunk(unsigned int chunkCount, const function<void(unsigned int)>& process);
+	float getTriangleCost(float gradientX, float gradientZ, float maxHeight, const NavigationGrid::Settings& settings);
+
+	const uint8_t NavigationGrid::BLOCKED;
+
+	NavigationGrid::NavigationGrid() :
+		chunkArea(0),
+		chunkNodes(),
+		chunkSize(0),
+		chunksPerEdge(0),
+		costs(),
+		edges(),
+		firstEdges(1, 0),
+		heights(),
+		nodeEdges(),
+		nodes()
+	{
+	}
+
+	NavigationGrid::NavigationGrid(const vector<vector<float>>& heightMap, unsigned int chunkSize,
+			const CollisionProxy* proxies, unsigned int proxyCount, const Settings& settings) :
+		chunkArea(chunkSize * chunkSize),
+		chunkNodes(),
+		chunkSize(chunkSize),
+		chunksPerEdge((heightMap.size() - 1) / chunkSize),
+		costs(heightMap.size() > 1 ? (heightMap.size() - 1) * (heightMap.size() - 1) : 0, BLOCKED),
+		edges(),
+		firstEdges(),
+		heights(heightMap),
+		nodeEdges(),
+		nodes()
+	{
+		classify(heightMap, settings);
+		addFootprints(proxies, proxyCount, settings.footprintPadding);
+		addPortals();
+		connectPortals();
+		flattenEdges();
+	}
+
+	NavigationGrid::NavigationGrid(const vector<vector<float>>& heightMap, unsigned int chunkSize) :
+		chunkArea(chunkSize * chunkSize),
+		chunkNodes(),
+		chunkSize(chunkSize),
+		chunksPerEdge((heightMap.size() - 1) / chunkSize),
+		costs(heightMap.size() > 1 ? (heightMap.size() - 1) * (heightMap.size() - 1) : 0, BLOCKED),
+		edges(),
+		firstEdges(),
+		heights(heightMap),
+		nodeEdges(),
+		nodes()
+	{
+	}
+
+	void NavigationGrid::addChunkPortals(unsigned int chunk)
+	{
+		unsigned int chunkX = chunk / chunksPerEdge;
+		unsigned int chunkZ = chunk % chunksPerEdge;
+		unsigned int minX = chunkX * chunkSize;
+		unsigned int minZ = chunkZ * chunkSize;
+
+		// Along the edge with the next chunk in x and then along the edge with the next chunk in z.
+		for (unsigned int axis = 0; axis < 2; axis++)
+		{
+			if ((axis == 0 && chunkX == chunksPerEdge - 1) || (axis == 1 && chunkZ == chunksPerEdge - 1))
+			{
+				continue;
+			}
+
+			unsigned int runStart = UINT_MAX;
+			for (unsigned int offset = 0; offset <= chunkSize; offset++)
+			{
+				bool open = false;
+				if (offset < chunkSize)
+				{
+					unsigned int x = axis == 0 ? minX + chunkSize - 1 : minX + offset;
+					unsigned int z = axis == 0 ? minZ + offset : minZ + chunkSize - 1;
+					open = costs[getCell(x, z)] != BLOCKED && costs[getCell(x + 1 - axis, z + axis)] != BLOCKED;
+				}
+
+				if (open && runStart == UINT_MAX)
+				{
+					runStart = offset;
+				}
+				else if (!open && runStart != UINT_MAX)
+				{
+					// One portal in the middle of each open stretch of the edge.
+					unsigned int middle = (runStart + offset - 1) / 2;
+					unsigned int x = axis == 0 ? minX + chunkSize - 1 : minX + middle;
+					unsigned int z = axis == 0 ? minZ + middle : minZ + chunkSize - 1;
+					unsigned int inside = getCell(x, z);
+					unsigned int outside = getCell(x + 1 - axis, z + axis);
+
+					unsigned int insideNode = nodes.size();
+					unsigned int outsideNode = insideNode + 1;
+					nodes.push_back(inside);
+					nodes.push_back(outside);
+					chunkNodes[inside / chunkArea].push_back(insideNode);
+					chunkNodes[outside / chunkArea].push_back(outsideNode);
+
+					float cost = (costs[inside] + costs[outside]) * 0.5f;
+					nodeEdges.push_back({ { cost, outsideNode } });
+					nodeEdges.push_back({ { cost, insideNode } });
+
+					runStart = UINT_MAX;
+				}
+			}
+		}
+	}
+
+	void NavigationGrid::addFootprints(const CollisionProxy* proxies, unsigned int proxyCount, float padding)
+	{
+		int cellsPerEdge = chunksPerEdge * chunkSize;
+		float halfEdgeLength = static_cast<float>(heights.getEdgeLength() / 2);
+
+		for (unsigned int index = 0; index < proxyCount; index++)
+		{
+			float centerX = proxies[index].position.X() + halfEdgeLength;
+			float centerZ = proxies[index].position.Z() + halfEdgeLength;
+			float radius = proxies[index].radius + padding;
+
+			int minX = max(static_cast<int>(floor(centerX - radius)), 0);
+			int minZ = max(static_cast<int>(floor(centerZ - radius)), 0);
+			int maxX = min(static_cast<int>(floor(centerX + radius)), cellsPerEdge - 1);
+			int maxZ = min(static_cast<int>(floor(centerZ + radius)), cellsPerEdge - 1);
+
+			for (int x = minX; x <= maxX; x++)
+			{
+				for (int z = minZ; z <= maxZ; z++)
+				{
+					float offsetX = x + 0.5f - centerX;
+					float offsetZ = z + 0.5f - centerZ;
+
+					// The cell the foliage stands in is always blocked, however thin the foliage is.
+					if (offsetX * offsetX + offsetZ * offsetZ <= radius * radius ||
+							(x == static_cast<int>(floor(centerX)) && z == static_cast<int>(floor(centerZ))))
+					{
+						costs[getCell(x, z)] = BLOCKED;
+					}
+				}
+			}
+		}
+	}
+
+	void NavigationGrid::addPortals()
+	{
+		chunkNodes.assign(getChunkCount(), vector<unsigned int>());
+
+		for (unsigned int chunk = 0; chunk < getChunkCount(); chunk++)
+		{
+			addChunkPortals(chunk);
+		}
+	}
+
+	bool NavigationGrid::build(const vector<vector<float>>& heightMap, const CollisionProxy* proxies,
+			unsigned int proxyCount, const Settings& settings, unsigned int step)
+	{
+		// The chunks are classified, then the foliage is added, then the chunks are given their portals and then
+		// they are connected.
+		unsigned int chunkCount = getChunkCount();
+		if (step < chunkCount)
+		{
+			classifyChunk(heightMap, step, settings);
+			return false;
+		}
+		step -= chunkCount;
+
+		if (step == 0)
+		{
+			addFootprints(proxies, proxyCount, settings.footprintPadding);
+			chunkNodes.assign(chunkCount, vector<unsigned int>());
+			return false;
+		}
+		step--;
+
+		if (step < chunkCount)
+		{
+			addChunkPortals(step);
+			return false;
+		}
+		step -= chunkCount;
+
+		if (step < chunkCount)
+		{
+			connectChunkPortals(step);
+			return false;
+		}
+
+		flattenEdges();
+
+		return true;
+	}
+
+	void NavigationGrid::classify(const vector<vector<float>>& heightMap, const Settings& settings)
+	{
+		forEachChunk(getChunkCount(), [&](unsigned int chunk)
+		{
+			classifyChunk(heightMap, chunk, settings);
+		});
+	}
+
+	void NavigationGrid::classifyChunk(const vector<vector<float>>& heightMap, unsigned int chunk,
+			const Settings& settings)
+	{
+		unsigned int minX = chunk / chunksPerEdge * chunkSize;
+		unsigned int minZ = chunk % chunksPerEdge * chunkSize;
+		uint8_t* chunkCosts = &costs[chunk * chunkArea];
+
+		for (unsigned int x = 0; x < chunkSize; x++)
+		{
+			const float* row0 = heightMap[minX + x].data() + minZ;
+			const float* row1 = heightMap[minX + x + 1].data() + minZ;
+
+			for (unsigned int z = 0; z < chunkSize; z++)
+			{
+				// The cell is split into the same two triangles as the terrain and costs as much as the worse.
+				float cost0 = getTriangleCost(row1[z + 1] - row0[z + 1], row0[z + 1] - row0[z],
+						max(row0[z], max(row0[z + 1], row1[z + 1])), settings);
+				float cost1 = getTriangleCost(row1[z] - row0[z], row1[z + 1] - row1[z],
+						max(row0[z], max(row1[z], row1[z + 1])), settings);
+
+				chunkCosts[x * chunkSize + z] = static_cast<uint8_t>(floor(max(cost0, cost1) + 0.5f));
+			}
+		}
+	}
+
+	void NavigationGrid::connectChunkPortals(unsigned int chunk)
+	{
+		vector<float> distances;
+		vector<unsigned int> previous;
+
+		for (unsigned int node : chunkNodes[chunk])
+		{
+			search(nodes[node], distances, previous);
+
+			for (unsigned int otherNode : chunkNodes[chunk])
+			{
+				float distance = distances[nodes[otherNode] % chunkArea];
+				if (otherNode != node && distance < FLT_MAX)
+				{
+					nodeEdges[node].push_back({ distance, otherNode });
+				}
+			}
+		}
+	}
+
+	void NavigationGrid::connectPortals()
+	{
+		// Each chunk only adds edges to its own nodes so the chunks can be connected at the same time.
+		forEachChunk(getChunkCount(), [&](unsigned int chunk)
+		{
+			connectChunkPortals(chunk);
+		});
+	}
+
+	bool NavigationGrid::findPath(const Vector3& start, const Vector3& end, vector<Vector3>& path) const
+	{
+		path.clear();
+		if (costs.empty())
+		{
+			return false;
+		}
+
+		unsigned int startCell = getCell(start);
+		unsigned int endCell = getCell(end);
+		if (costs[startCell] == BLOCKED || costs[endCell] == BLOCKED)
+		{
+			return false;
+		}
+
+		unsigned int startChunk = startCell / chunkArea;
+		unsigned int endChunk = endCell / chunkArea;
+
+		vector<float> startDistances;
+		vector<unsigned int> startPrevious;
+		search(startCell, startDistances, startPrevious);
+
+		vector<float> endDistances;
+		vector<unsigned int> endPrevious;
+		search(endCell, endDistances, endPrevious);
+
+		// A path within the chunk is only used if going through the other chunks is no cheaper.
+		float bestCost = FLT_MAX;
+		if (startChunk == endChunk)
+		{
+			bestCost = startDistances[endCell % chunkArea];
+		}
+		unsigned int bestNode = UINT_MAX;
+
+		Vector3 endPosition = getPosition(endCell);
+		auto getHeuristic = [&](unsigned int node)
+		{
+			Vector3 nodePosition = getPosition(nodes[node]);
+			float offsetX = endPosition.X() - nodePosition.X();
+			float offsetZ = endPosition.Z() - nodePosition.Z();
+
+			return sqrt(offsetX * offsetX + offsetZ * offsetZ);
+		};
+
+		vector<float> costsSoFar(nodes.size(), FLT_MAX);
+		vector<unsigned int> parents(nodes.size(), UINT_MAX);
+		vector<bool> closed(nodes.size(), false);
+		Queue open;
+
+		for (unsigned int node : chunkNodes[startChunk])
+		{
+			costsSoFar[node] = startDistances[nodes[node] % chunkArea];
+			if (costsSoFar[node] < FLT_MAX)
+			{
+				open.push(QueueEntry(costsSoFar[node] + getHeuristic(node), node));
+			}
+		}
+
+		while (!open.empty() && open.top().first < bestCost)
+		{
+			unsigned int node = open.top().second;
+			open.pop();
+			if (closed[node])
+			{
+				continue;
+			}
+			closed[node] = true;
+
+			if (nodes[node] / chunkArea == endChunk && endDistances[nodes[node] % chunkArea] < FLT_MAX &&
+					costsSoFar[node] + endDistances[nodes[node] % chunkArea] < bestCost)
+			{
+				bestCost = costsSoFar[node] + endDistances[nodes[node] % chunkArea];
+				bestNode = node;
+			}
+
+			for (unsigned int index = firstEdges[node]; index < firstEdges[node + 1]; index++)
+			{
+				const Edge& edge = edges[index];
+				float cost = costsSoFar[node] + edge.cost;
+				if (cost < costsSoFar[edge.node])
+				{
+					costsSoFar[edge.node] = cost;
+					parents[edge.node] = node;
+					open.push(QueueEntry(cost + getHeuristic(edge.node), edge.node));
+				}
+			}
+		}
+
+		if (bestCost == FLT_MAX)
+		{
+			return false;
+		}
+
+		// Refine the path through the nodes into cells.
+		vector<unsigned int> cells;
+		if (bestNode == UINT_MAX)
+		{
+			trace(startPrevious, endCell, true, cells);
+		}
+		else
+		{
+			vector<unsigned int> route;
+			for (unsigned int node = bestNode; node != UINT_MAX; node = parents[node])
+			{
+				route.push_back(node);
+			}
+			reverse(route.begin(), route.end());
+
+			trace(startPrevious, nodes[route.front()], true, cells);
+
+			vector<float> distances;
+			vector<unsigned int> previous;
+			for (unsigned int index = 1; index < route.size(); index++)
+			{
+				unsigned int from = nodes[route[index - 1]];
+				unsigned int to = nodes[route[index]];
+
+				// Nodes in different chunks are neighbouring cells.
+				if (from / chunkArea == to / chunkArea)
+				{
+					search(from, distances, previous);
+					trace(previous, to, true, cells);
+				}
+				else
+				{
+					cells.push_back(to);
+				}
+			}
+
+			trace(endPrevious, nodes[route.back()], false, cells);
+		}
+
+		path.reserve(cells.size());
+		for (unsigned int cell : cells)
+		{
+			path.push_back(getPosition(cell));
+		}
+
+		return true;
+	}
+
+	void NavigationGrid::flattenEdges()
+	{
+		firstEdges.reserve(nodes.size() + 1);
+		firstEdges.push_back(0);
+		for (const vector<Edge>& edgesOfNode : nodeEdges)
+		{
+			edges.insert(edges.end(), edgesOfNode.begin(), edgesOfNode.end());
+			firstEdges.push_back(edges.size());
+		}
+
+		vector<vector<Edge>>().swap(nodeEdges);
+	}
+
+	void forEachChunk(unsigned int chunkCount, const function<void(unsigned int)>& process)
+	{
+		unsigned int workerCount = min(max(1u, thread::hardware_concurrency()), max(1u, chunkCount));
+
+		auto processChunks = [&](unsigned int worker)
+		{
+			for (unsigned int chunk = worker; chunk < chunkCount; chunk += workerCount)
+			{
+				process(chunk);
+			}
+		};
+
+		vector<future<void>> workers;
+		for (unsigned int worker = 1; worker < workerCount; worker++)
+		{
+			workers.push_back(async(launch::async, processChunks, worker));
+		}
+		processChunks(0);
+
+		for (future<void>& worker : workers)
+		{
+			worker.get();
+		}
+	}
+
+	unsigned int NavigationGrid::getCell(unsigned int x, unsigned int z) const
+	{
+		unsigned int chunk = x / chunkSize * chunksPerEdge + z / chunkSize;
+
+		return chunk * chunkArea + x % chunkSize * chunkSize + z % chunkSize;
+	}
+
+	unsigned int NavigationGrid::getCell(const Vector3& position) const
+	{
+		float x = 0.0f;
+		float z = 0.0f;
+		HeightMapFunctions::getCoordinates(heights.getEdgeLength(), position, x, z);
+
+		float maxCoordinate = static_cast<float>(chunksPerEdge * chunkSize - 1);
+		x = min(max(floor(x), 0.0f), maxCoordinate);
+		z = min(max(floor(z), 0.0f), maxCoordinate);
+
+		return getCell(static_cast<unsigned int>(x), static_cast<unsigned int>(z));
+	}
+
+	unsigned int NavigationGrid::getChunk(const Vector3& position) const
+	{
+		if (costs.empty())
+		{
+			return 0;
+		}
+
+		return getCell(position) / chunkArea;
+	}
+
+	unsigned int NavigationGrid::getChunkCount() const
+	{
+		return chunksPerEdge * chunksPerEdge;
+	}
+
+	const uint8_t* NavigationGrid::getChunkCosts(unsigned int chunk) const
+	{
+		return &costs[chunk * chunkArea];
+	}
+
+	const vector<unsigned int>& NavigationGrid::getChunkNodes(unsigned int chunk) const
+	{
+		return chunkNodes[chunk];
+	}
+
+	unsigned int NavigationGrid::getChunkSize() const
+	{
+		return chunkSize;
+	}
+
+	uint8_t NavigationGrid::getCost(const Vector3& position) const
+	{
+		if (costs.empty())
+		{
+			return BLOCKED;
+		}
+
+		return costs[getCell(position)];
+	}
+
+	const NavigationGrid::Edge* NavigationGrid::getEdges(unsigned int node, unsigned int& edgeCount) const
+	{
+		edgeCount = firstEdges[node + 1] - firstEdges[node];
+
+		return edges.data() + firstEdges[node];
+	}
+
+	unsigned int NavigationGrid::getNodeCount() const
+	{
+		return nodes.size();
+	}
+
+	Vector3 NavigationGrid::getNodePosition(unsigned int node) const
+	{
+		return getPosition(nodes[node]);
+	}
+
+	Vector3 NavigationGrid::getPosition(unsigned int cell) const
+	{
+		unsigned int chunk = cell / chunkArea;
+		unsigned int local = cell % chunkArea;
+		float x = chunk / chunksPerEdge * chunkSize + local / chunkSize + 0.5f;
+		float z = chunk % chunksPerEdge * chunkSize + local % chunkSize + 0.5f;
+		float halfEdgeLength = static_cast<float>(heights.getEdgeLength() / 2);
+
+		return Vector3(x - halfEdgeLength, heights.getHeight(x, z), z - halfEdgeLength);
+	}
+
+	float getTriangleCost(float gradientX, float gradientZ, float maxHeight, const NavigationGrid::Settings& settings)
+	{
+		float flatness = 1.0f / sqrt(1.0f + gradientX * gradientX + gradientZ * gradientZ);
+
+		// Deep water is classified as submerged.
+		unsigned char biome = Biomes::getBiome(flatness, maxHeight, -settings.maxWaterDepth);
+		if (biome == Biomes::CLIFF || biome == Biomes::SUBMERGED)
+		{
+			return NavigationGrid::BLOCKED;
+		}
+
+		float cost = 1.0f + settings.slopeCost * (1.0f - flatness);
+		if (biome == Biomes::SNOW)
+		{
+			cost += settings.snowCost;
+		}
+		if (maxHeight < 0.0f)
+		{
+			cost += settings.waterCost;
+		}
+
+		return min(cost, NavigationGrid::BLOCKED - 1.0f);
+	}
+
+	void NavigationGrid::search(unsigned int cell, vector<float>& distances, vector<unsigned int>& previous) const
+	{
+		// Dijkstra's algorithm over the cells of the chunk, eight ways without cutting the corners of blocked cells.
+		// Moving between two cells costs the average of their costs for each unit walked.
+		const uint8_t* chunkCosts = &costs[cell / chunkArea * chunkArea];
+		int size = chunkSize;
+
+		distances.assign(chunkArea, FLT_MAX);
+		previous.assign(chunkArea, UINT_MAX);
+
+		Queue open;
+		distances[cell % chunkArea] = 0.0f;
+		open.push(QueueEntry(0.0f, cell % chunkArea));
+
+		while (!open.empty())
+		{
+			QueueEntry entry = open.top();
+			open.pop();
+			if (entry.first > distances[entry.second])
+			{
+				continue;
+			}
+
+			int x = entry.second / chunkSize;
+			int z = entry.second % chunkSize;
+
+			for (int neighbourX = max(x - 1, 0); neighbourX <= min(x + 1, size - 1); neighbourX++)
+			{
+				for (int neighbourZ = max(z - 1, 0); neighbourZ <= min(z + 1, size - 1); neighbourZ++)
+				{
+					unsigned int neighbour = neighbourX * size + neighbourZ;
+					if (neighbour == entry.second || chunkCosts[neighbour] == BLOCKED)
+					{
+						continue;
+					}
+
+					bool diagonal = neighbourX != x && neighbourZ != z;
+					if (diagonal && (chunkCosts[neighbourX * size + z] == BLOCKED ||
+							chunkCosts[x * size + neighbourZ] == BLOCKED))
+					{
+						continue;
+					}
+
+					float distance = entry.first + (chunkCosts[entry.second] + chunkCosts[neighbour]) * 0.5f *
+							(diagonal ? DIAGONAL_LENGTH : 1.0f);
+					if (distance < distances[neighbour])
+					{
+						distances[neighbour] = distance;
+						previous[neighbour] = entry.second;
+						open.push(QueueEntry(distance, neighbour));
+					}
+				}
+			}
+		}
+	}
+
+	void NavigationGrid::trace(const vector<unsigned int>& previous, unsigned int cell, bool forwards,
+			vector<unsigned int>& cells) const
+	{
+		unsigned int chunkStart = cell / chunkArea * chunkArea;
+
+		vector<unsigned int> leg;
+		for (unsigned int local = cell % chunkArea; local != UINT_MAX; local = previous[local])
+		{
+			leg.push_back(chunkStart + local);
+		}
+
+		if (forwards)
+		{
+			reverse(leg.begin(), leg.end());
+		}
+
+		for (unsigned int legCell : leg)
+		{
+			if (cells.empty() || cells.back() != legCell)
+			{
+				cells.push_back(legCell);
+			}
+		}
+	}
+}
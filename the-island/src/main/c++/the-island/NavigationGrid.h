@@ -0,0 +1,168 @@
+/*
+ * Copyright © 2014 Simple Entertainment Limited
+ *
+ * This file is part of The Island.
+ *
+ * The Island is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * The Island is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with The Island. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#ifndef NAVIGATIONGRID_H_
+#define NAVIGATIONGRID_H_
+
+#include <cstdint>
+#include <vector>
+
+#include <simplicity/API.h>
+
+#include "CollisionProxy.h"
+#include "QuantizedHeightMap.h"
+
+namespace theisland
+{
+	/**
+	 * <p>
+	 * The cost of walking across each cell of a height map, stored chunk by chunk in the same order as the chunks of
+	 * the island, and a coarse graph for finding paths across the chunks. The nodes of the graph are the portals
+	 * between neighbouring chunks (one for each open stretch of their shared edge) and each node is connected to the
+	 * portals it can reach within its chunk.
+	 * </p>
+	 */
+	class SIMPLE_API NavigationGrid
+	{
+		public:
+			// The cost of a cell that cannot be walked across (cliffs, deep water and foliage).
+			static const std::uint8_t BLOCKED = 255;
+
+			struct Edge
+			{
+				float cost;
+
+				unsigned int node;
+			};
+
+			struct Settings
+			{
+				// Foliage blocks the cells within its radius plus this.
+				float footprintPadding = 0.5f;
+
+				// The deepest water that can be waded through.
+				float maxWaterDepth = 0.5f;
+
+				// How much the steepest walkable slopes add to the cost of a cell.
+				float slopeCost = 8.0f;
+
+				// How much snow adds to the cost of a cell.
+				float snowCost = 2.0f;
+
+				// How much wading through water adds to the cost of a cell.
+				float waterCost = 4.0f;
+			};
+
+			NavigationGrid();
+
+			// The cells are classified and the chunks connected in parallel. The chunk size has to divide the edge of
+			// the height map (less one) as it does for the island.
+			NavigationGrid(const std::vector<std::vector<float>>& heightMap, unsigned int chunkSize,
+					const CollisionProxy* proxies, unsigned int proxyCount, const Settings& settings);
+
+			// An empty grid to be built a step at a time on this thread.
+			NavigationGrid(const std::vector<std::vector<float>>& heightMap, unsigned int chunkSize);
+
+			// Takes one step of building the grid (a chunk at a time) and returns true once it is built. Taking every
+			// step in order builds the same grid as the parallel constructor does.
+			bool build(const std::vector<std::vector<float>>& heightMap, const CollisionProxy* proxies,
+					unsigned int proxyCount, const Settings& settings, unsigned int step);
+
+			// Finds the cheapest path between the cells beneath two positions as the centres of the cells along it.
+			// Returns false if there is none.
+			bool findPath(const simplicity::Vector3& start, const simplicity::Vector3& end,
+					std::vector<simplicity::Vector3>& path) const;
+
+			// The index of the chunk the position is in.
+			unsigned int getChunk(const simplicity::Vector3& position) const;
+
+			unsigned int getChunkCount() const;
+
+			// The costs of the cells of a chunk (chunk size by chunk size, all the cells with the same x coordinate
+			// together).
+			const std::uint8_t* getChunkCosts(unsigned int chunk) const;
+
+			// The nodes in a chunk.
+			const std::vector<unsigned int>& getChunkNodes(unsigned int chunk) const;
+
+			unsigned int getChunkSize() const;
+
+			// The cost of the cell beneath a position (clamped to the grid).
+			std::uint8_t getCost(const simplicity::Vector3& position) const;
+
+			const Edge* getEdges(unsigned int node, unsigned int& edgeCount) const;
+
+			unsigned int getNodeCount() const;
+
+			simplicity::Vector3 getNodePosition(unsigned int node) const;
+
+		private:
+			unsigned int chunkArea;
+
+			std::vector<std::vector<unsigned int>> chunkNodes;
+
+			unsigned int chunkSize;
+
+			unsigned int chunksPerEdge;
+
+			std::vector<std::uint8_t> costs;
+
+			std::vector<Edge> edges;
+
+			std::vector<unsigned int> firstEdges;
+
+			QuantizedHeightMap heights;
+
+			// The edges of each node while the grid is being built.
+			std::vector<std::vector<Edge>> nodeEdges;
+
+			// The cell of each node.
+			std::vector<unsigned int> nodes;
+
+			void addChunkPortals(unsigned int chunk);
+
+			void addFootprints(const CollisionProxy* proxies, unsigned int proxyCount, float padding);
+
+			void addPortals();
+
+			void classify(const std::vector<std::vector<float>>& heightMap, const Settings& settings);
+
+			void classifyChunk(const std::vector<std::vector<float>>& heightMap, unsigned int chunk,
+					const Settings& settings);
+
+			void connectChunkPortals(unsigned int chunk);
+
+			void connectPortals();
+
+			// The edges of all the nodes are kept in one list once they are connected.
+			void flattenEdges();
+
+			unsigned int getCell(unsigned int x, unsigned int z) const;
+
+			unsigned int getCell(const simplicity::Vector3& position) const;
+
+			simplicity::Vector3 getPosition(unsigned int cell) const;
+
+			void search(unsigned int cell, std::vector<float>& distances, std::vector<unsigned int>& previous) const;
+
+			// Appends the cells along the path found by the last search to a cell, from where the search started to
+			// the cell if forwards or the other way if not.
+			void trace(const std::vector<unsigned int>& previous, unsigned int cell, bool forwards,
+					std::vector<unsigned int>& cells) const;
+	};
+}
+
+#endif /* NAVIGATIONGRID_H_ */
@@ -0,0 +1,367 @@
+/*
+ * Copyright © 2014 Simple Entertainment Limited
+ *
+ * This file is part of The Island.
+ *
+ * The Island is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * The Island is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with The Island. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <climits>
+
+#if (defined(__SSE2__) || defined(_M_X64)) && !defined(THE_ISLAND_SCALAR)
+#include <emmintrin.h>
+#endif
+
+#include "OceanClipmap.h"
+
+using namespace simplicity;
+using namespace std;
+
+static const float GRAVITY = 9.81f;
+static const float TWO_PI = 6.28318531f;
+
+// Adding and then subtracting this rounds a float to the nearest integer (for magnitudes under 2^22).
+static const float ROUNDING = 12582912.0f;
+
+// The parabolic sine approximation.
+static const float SINE_B = 4.0f / 3.14159265f;
+static const float SINE_C = -4.0f / (3.14159265f * 3.14159265f);
+static const float SINE_P = 0.225f;
+
+namespace theisland
+{
+	float getSine(float angle);
+
+#if (defined(__SSE2__) || defined(_M_X64)) && !defined(THE_ISLAND_SCALAR)
+	__m128 getSines(__m128 angles);
+#endif
+
+	OceanClipmap::OceanClipmap(unsigned int levelCount, unsigned int resolution, float cellSize, float extent) :
+		baseX(),
+		baseZ(),
+		mesh(),
+		normalX(),
+		normalY(),
+		normalZ(),
+		positionX(),
+		positionY(),
+		positionZ(),
+		snapSize(cellSize * (1 << levelCount)),
+		stitches(),
+		waveFactors(),
+		waves()
+	{
+		vector<unsigned int> indices;
+		build(levelCount, resolution, cellSize, extent, indices);
+
+		shared_ptr<MeshBuffer> buffer = ModelFactory::getInstance()->createMeshBuffer(baseX.size(), indices.size(),
+				Buffer::AccessHint::WRITE);
+		mesh.reset(new Mesh(buffer));
+
+		// The indices never change so only the vertices are written on update.
+		MeshData& meshData = mesh->getData(false);
+		meshData.indexCount = indices.size();
+		memcpy(meshData.indexData, indices.data(), indices.size() * sizeof(unsigned int));
+		mesh->releaseData();
+
+		update(Vector3(0.0f, 0.0f, 0.0f), 0.0f);
+	}
+
+	void OceanClipmap::addWave(const Wave& wave)
+	{
+		waves.push_back(wave);
+	}
+
+	void OceanClipmap::build(unsigned int levelCount, unsigned int resolution, float cellSize, float extent,
+			vector<unsigned int>& indices)
+	{
+		int half = resolution / 2;
+		int quarter = resolution / 4;
+		unsigned int edgeVertexCount = resolution + 1;
+		vector<unsigned int> levelIndices(edgeVertexCount * edgeVertexCount);
+
+		for (unsigned int level = 0; level < levelCount; level++)
+		{
+			float spacing = cellSize * (1 << level);
+
+			// The outermost edge is stretched out to the extent of the ocean.
+			float stretch = 1.0f;
+			if (level == levelCount - 1 && extent > half * spacing)
+			{
+				stretch = extent / (half * spacing);
+			}
+
+			// Every level but the first has a hole in the middle where the level inside it is.
+			fill(levelIndices.begin(), levelIndices.end(), UINT_MAX);
+			for (int x = -half; x <= half; x++)
+			{
+				for (int z = -half; z <= half; z++)
+				{
+					int ring = max(abs(x), abs(z));
+					if (level > 0 && ring < quarter)
+					{
+						continue;
+					}
+
+					levelIndices[(x + half) * edgeVertexCount + z + half] = baseX.size();
+					baseX.push_back(x * spacing * (ring == half ? stretch : 1.0f));
+					baseZ.push_back(z * spacing * (ring == half ? stretch : 1.0f));
+				}
+			}
+
+			for (int x = -half; x < half; x++)
+			{
+				for (int z = -half; z < half; z++)
+				{
+					if (level > 0 && x >= -quarter && x < quarter && z >= -quarter && z < quarter)
+					{
+						continue;
+					}
+
+					unsigned int index00 = levelIndices[(x + half) * edgeVertexCount + z + half];
+					unsigned int index01 = levelIndices[(x + half) * edgeVertexCount + z + half + 1];
+					unsigned int index10 = levelIndices[(x + half + 1) * edgeVertexCount + z + half];
+					unsigned int index11 = levelIndices[(x + half + 1) * edgeVertexCount + z + half + 1];
+
+					// Wound so that the normals point up.
+					indices.push_back(index00);
+					indices.push_back(index01);
+					indices.push_back(index10);
+					indices.push_back(index01);
+					indices.push_back(index11);
+					indices.push_back(index10);
+				}
+			}
+
+			// The vertices at odd positions along the outer edge fall between the vertices of the next level.
+			if (level < levelCount - 1)
+			{
+				for (int along = -half + 1; along < half; along += 2)
+				{
+					for (int side : { -half, half })
+					{
+						Stitch stitch;
+						stitch.vertex = levelIndices[(side + half) * edgeVertexCount + along + half];
+						stitch.neighbour0 = levelIndices[(side + half) * edgeVertexCount + along + half - 1];
+						stitch.neighbour1 = levelIndices[(side + half) * edgeVertexCount + along + half + 1];
+						stitches.push_back(stitch);
+
+						stitch.vertex = levelIndices[(along + half) * edgeVertexCount + side + half];
+						stitch.neighbour0 = levelIndices[(along + half - 1) * edgeVertexCount + side + half];
+						stitch.neighbour1 = levelIndices[(along + half + 1) * edgeVertexCount + side + half];
+						stitches.push_back(stitch);
+					}
+				}
+			}
+		}
+
+		normalX.resize(baseX.size());
+		normalY.resize(baseX.size());
+		normalZ.resize(baseX.size());
+		positionX.resize(baseX.size());
+		positionY.resize(baseX.size());
+		positionZ.resize(baseX.size());
+	}
+
+	void OceanClipmap::displace(const Vector2& center, float time)
+	{
+		// The parts of the waves that are the same for every vertex.
+		unsigned int waveCount = waves.size();
+		waveFactors.resize(waveCount * 8);
+		for (unsigned int index = 0; index < waveCount; index++)
+		{
+			const Wave& wave = waves[index];
+			float frequency = TWO_PI / wave.wavelength;
+
+			// Deep water waves turn at the square root of gravity times their frequency (in radians per second).
+			float angularFrequency = sqrt(GRAVITY * frequency);
+
+			// The steepness is shared between the waves so that the crests never loop over themselves.
+			float horizontal = wave.steepness / (frequency * waveCount);
+
+			float* factors = &waveFactors[index * 8];
+			factors[0] = wave.direction.X() * frequency;
+			factors[1] = wave.direction.Y() * frequency;
+			factors[2] = static_cast<float>(fmod(static_cast<double>(angularFrequency) * time, TWO_PI));
+			factors[3] = wave.amplitude;
+			factors[4] = wave.direction.X() * horizontal;
+			factors[5] = wave.direction.Y() * horizontal;
+			factors[6] = frequency * wave.amplitude;
+			factors[7] = wave.steepness / waveCount;
+		}
+
+		unsigned int vertexCount = baseX.size();
+		unsigned int vertex = 0;
+
+#if (defined(__SSE2__) || defined(_M_X64)) && !defined(THE_ISLAND_SCALAR)
+		__m128 centerX = _mm_set1_ps(center.X());
+		__m128 centerZ = _mm_set1_ps(center.Y());
+		__m128 quarterTurn = _mm_set1_ps(TWO_PI / 4.0f);
+
+		for (; vertex + 4 <= vertexCount; vertex += 4)
+		{
+			__m128 x = _mm_add_ps(centerX, _mm_loadu_ps(&baseX[vertex]));
+			__m128 z = _mm_add_ps(centerZ, _mm_loadu_ps(&baseZ[vertex]));
+			__m128 displacedX = x;
+			__m128 displacedY = _mm_setzero_ps();
+			__m128 displacedZ = z;
+			__m128 slopeX = _mm_setzero_ps();
+			__m128 slopeY = _mm_set1_ps(1.0f);
+			__m128 slopeZ = _mm_setzero_ps();
+
+			for (unsigned int index = 0; index < waveCount; index++)
+			{
+				const float* factors = &waveFactors[index * 8];
+				__m128 angle = _mm_sub_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(factors[0]), x),
+						_mm_mul_ps(_mm_set1_ps(factors[1]), z)), _mm_set1_ps(factors[2]));
+				__m128 sine = getSines(angle);
+				__m128 cosine = getSines(_mm_add_ps(angle, quarterTurn));
+
+				displacedX = _mm_add_ps(displacedX, _mm_mul_ps(_mm_set1_ps(factors[4]), cosine));
+				displacedY = _mm_add_ps(displacedY, _mm_mul_ps(_mm_set1_ps(factors[3]), sine));
+				displacedZ = _mm_add_ps(displacedZ, _mm_mul_ps(_mm_set1_ps(factors[5]), cosine));
+
+				__m128 slope = _mm_mul_ps(_mm_set1_ps(factors[6]), cosine);
+				slopeX = _mm_sub_ps(slopeX, _mm_mul_ps(_mm_set1_ps(waves[index].direction.X()), slope));
+				slopeY = _mm_sub_ps(slopeY, _mm_mul_ps(_mm_set1_ps(factors[7]), sine));
+				slopeZ = _mm_sub_ps(slopeZ, _mm_mul_ps(_mm_set1_ps(waves[index].direction.Y()), slope));
+			}
+
+			__m128 magnitude = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(slopeX, slopeX),
+					_mm_mul_ps(slopeY, slopeY)), _mm_mul_ps(slopeZ, slopeZ)));
+
+			_mm_storeu_ps(&positionX[vertex], displacedX);
+			_mm_storeu_ps(&positionY[vertex], displacedY);
+			_mm_storeu_ps(&positionZ[vertex], displacedZ);
+			_mm_storeu_ps(&normalX[vertex], _mm_div_ps(slopeX, magnitude));
+			_mm_storeu_ps(&normalY[vertex], _mm_div_ps(slopeY, magnitude));
+			_mm_storeu_ps(&normalZ[vertex], _mm_div_ps(slopeZ, magnitude));
+		}
+#endif
+
+		for (; vertex < vertexCount; vertex++)
+		{
+			float x = center.X() + baseX[vertex];
+			float z = center.Y() + baseZ[vertex];
+			float displacedX = x;
+			float displacedY = 0.0f;
+			float displacedZ = z;
+			float slopeX = 0.0f;
+			float slopeY = 1.0f;
+			float slopeZ = 0.0f;
+
+			for (unsigned int index = 0; index < waveCount; index++)
+			{
+				const float* factors = &waveFactors[index * 8];
+				float angle = factors[0] * x + factors[1] * z - factors[2];
+				float sine = getSine(angle);
+				float cosine = getSine(angle + TWO_PI / 4.0f);
+
+				displacedX += factors[4] * cosine;
+				displacedY += factors[3] * sine;
+				displacedZ += factors[5] * cosine;
+
+				float slope = factors[6] * cosine;
+				slopeX -= waves[index].direction.X() * slope;
+				slopeY -= factors[7] * sine;
+				slopeZ -= waves[index].direction.Y() * slope;
+			}
+
+			float magnitude = sqrt(slopeX * slopeX + slopeY * slopeY + slopeZ * slopeZ);
+
+			positionX[vertex] = displacedX;
+			positionY[vertex] = displacedY;
+			positionZ[vertex] = displacedZ;
+			normalX[vertex] = slopeX / magnitude;
+			normalY[vertex] = slopeY / magnitude;
+			normalZ[vertex] = slopeZ / magnitude;
+		}
+
+		for (const Stitch& stitch : stitches)
+		{
+			positionX[stitch.vertex] = (positionX[stitch.neighbour0] + positionX[stitch.neighbour1]) / 2.0f;
+			positionY[stitch.vertex] = (positionY[stitch.neighbour0] + positionY[stitch.neighbour1]) / 2.0f;
+			positionZ[stitch.vertex] = (positionZ[stitch.neighbour0] + positionZ[stitch.neighbour1]) / 2.0f;
+
+			Vector3 normal(normalX[stitch.neighbour0] + normalX[stitch.neighbour1],
+					normalY[stitch.neighbour0] + normalY[stitch.neighbour1],
+					normalZ[stitch.neighbour0] + normalZ[stitch.neighbour1]);
+			normal.normalize();
+			normalX[stitch.vertex] = normal.X();
+			normalY[stitch.vertex] = normal.Y();
+			normalZ[stitch.vertex] = normal.Z();
+		}
+	}
+
+	shared_ptr<Mesh> OceanClipmap::getMesh() const
+	{
+		return mesh;
+	}
+
+	float getSine(float angle)
+	{
+		// Wraps the angle into [-pi, pi] and fits a parabola to the sine, then corrects it with a second one.
+		float turns = angle / TWO_PI;
+		float wrapped = (turns - ((turns + ROUNDING) - ROUNDING)) * TWO_PI;
+		float estimate = SINE_B * wrapped + SINE_C * wrapped * fabs(wrapped);
+
+		return SINE_P * (estimate * fabs(estimate) - estimate) + estimate;
+	}
+
+#if (defined(__SSE2__) || defined(_M_X64)) && !defined(THE_ISLAND_SCALAR)
+	__m128 getSines(__m128 angles)
+	{
+		__m128 absoluteMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+		__m128 rounding = _mm_set1_ps(ROUNDING);
+
+		__m128 turns = _mm_div_ps(angles, _mm_set1_ps(TWO_PI));
+		__m128 wrapped = _mm_mul_ps(_mm_sub_ps(turns, _mm_sub_ps(_mm_add_ps(turns, rounding), rounding)),
+				_mm_set1_ps(TWO_PI));
+		__m128 estimate = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(SINE_B), wrapped),
+				_mm_mul_ps(_mm_mul_ps(_mm_set1_ps(SINE_C), wrapped), _mm_and_ps(wrapped, absoluteMask)));
+
+		return _mm_add_ps(_mm_mul_ps(_mm_set1_ps(SINE_P), _mm_sub_ps(_mm_mul_ps(estimate,
+				_mm_and_ps(estimate, absoluteMask)), estimate)), estimate);
+	}
+#endif
+
+	const vector<OceanClipmap::Wave>& OceanClipmap::getWaves() const
+	{
+		return waves;
+	}
+
+	void OceanClipmap::update(const Vector3& cameraPosition, float time)
+	{
+		// The rings move in steps of the largest cells so that every vertex stays on the same spot of the waves.
+		Vector2 center(floor(cameraPosition.X() / snapSize) * snapSize,
+				floor(cameraPosition.Z() / snapSize) * snapSize);
+
+		displace(center, time);
+		write();
+	}
+
+	void OceanClipmap::write()
+	{
+		MeshData& meshData = mesh->getData(false);
+
+		meshData.vertexCount = baseX.size();
+		for (unsigned int index = 0; index < meshData.vertexCount; index++)
+		{
+			Vertex& vertex = meshData.vertexData[index];
+			vertex.color = Vector4(0.0f, 0.4f, 0.6f, 1.0f);
+			vertex.normal = Vector3(normalX[index], normalY[index], normalZ[index]);
+			vertex.position = Vector3(positionX[index], positionY[index], positionZ[index]);
+			vertex.texCoord = Vector2(0.0f, 0.0f);
+		}
+
+		mesh->releaseData();
+	}
+}
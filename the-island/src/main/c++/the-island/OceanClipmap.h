@@ -0,0 +1,112 @@
+/*
+ * Copyright © 2014 Simple Entertainment Limited
+ *
+ * This file is part of The Island.
+ *
+ * The Island is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * The Island is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with The Island. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#ifndef OCEANCLIPMAP_H_
+#define OCEANCLIPMAP_H_
+
+#include <memory>
+#include <vector>
+
+#include <simplicity/API.h>
+
+namespace theisland
+{
+	/**
+	 * <p>
+	 * An ocean surface made of concentric square rings of cells, each ring with cells twice the size of the ring inside
+	 * it, centred on the camera. The vertices are displaced by a sum of Gerstner waves. The number of vertices only
+	 * depends on the number of levels and their resolution, the edge of the outermost ring is stretched out to the
+	 * extent of the ocean. The host calls update every frame.
+	 * </p>
+	 */
+	class SIMPLE_API OceanClipmap
+	{
+		public:
+			struct Wave
+			{
+				float amplitude;
+
+				// The direction the wave travels in across the XZ plane (normalized).
+				simplicity::Vector2 direction;
+
+				// How sharp the crests are (0 to 1, 0 for a sine wave).
+				float steepness;
+
+				float wavelength;
+			};
+
+			// The resolution is the number of cells along the edge of each level (a multiple of four).
+			OceanClipmap(unsigned int levelCount = 5, unsigned int resolution = 32, float cellSize = 2.0f,
+					float extent = 1200.0f);
+
+			void addWave(const Wave& wave);
+
+			std::shared_ptr<simplicity::Mesh> getMesh() const;
+
+			const std::vector<Wave>& getWaves() const;
+
+			// Moves the rings to the camera and displaces the vertices by the waves at the given time (in seconds).
+			void update(const simplicity::Vector3& cameraPosition, float time);
+
+		private:
+			// A vertex on the outer edge of a level between two vertices of the coarser level around it. It takes the
+			// average of their displacements so that there are no cracks between the levels.
+			struct Stitch
+			{
+				unsigned int vertex;
+
+				unsigned int neighbour0;
+
+				unsigned int neighbour1;
+			};
+
+			std::vector<float> baseX;
+
+			std::vector<float> baseZ;
+
+			std::shared_ptr<simplicity::Mesh> mesh;
+
+			std::vector<float> normalX;
+
+			std::vector<float> normalY;
+
+			std::vector<float> normalZ;
+
+			std::vector<float> positionX;
+
+			std::vector<float> positionY;
+
+			std::vector<float> positionZ;
+
+			float snapSize;
+
+			std::vector<Stitch> stitches;
+
+			// The parts of the waves that are the same for every vertex, eight per wave.
+			std::vector<float> waveFactors;
+
+			std::vector<Wave> waves;
+
+			void build(unsigned int levelCount, unsigned int resolution, float cellSize, float extent,
+					std::vector<unsigned int>& indices);
+
+			void displace(const simplicity::Vector2& center, float time);
+
+			void write();
+	};
+}
+
+#endif /* OCEANCLIPMAP_H_ */
@@ -0,0 +1,191 @@
+/*
+ * Copyright © 2014 Simple Entertainment Limited
+ *
+ * This file is part of The Island.
+ *
+ * The Island is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * The Island is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with The Island. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <cfloat>
+
+#if (defined(__SSE2__) || defined(_M_X64)) && !defined(THE_ISLAND_SCALAR)
+#include <emmintrin.h>
+#endif
+
+#include "QuantizedHeightMap.h"
+
+using namespace simplicity;
+using namespace std;
+
+static const uint32_t MAGIC = 0x48544d51; // "QMTH"
+
+namespace theisland
+{
+	QuantizedHeightMap::QuantizedHeightMap() :
+		edgeLength(0),
+		heights(),
+		offset(0.0f),
+		scale(1.0f)
+	{
+	}
+
+	QuantizedHeightMap::QuantizedHeightMap(const vector<vector<float>>& heightMap) :
+		QuantizedHeightMap()
+	{
+		float minHeight = FLT_MAX;
+		float maxHeight = -FLT_MAX;
+		for (const vector<float>& row : heightMap)
+		{
+			for (float height : row)
+			{
+				minHeight = min(minHeight, height);
+				maxHeight = max(maxHeight, height);
+			}
+		}
+
+		*this = QuantizedHeightMap(heightMap.size(), minHeight, maxHeight);
+
+		for (unsigned int x = 0; x < edgeLength; x++)
+		{
+			encodeRow(x, heightMap[x].data());
+		}
+	}
+
+	QuantizedHeightMap::QuantizedHeightMap(unsigned int edgeLength, float minHeight, float maxHeight) :
+		edgeLength(edgeLength),
+		heights(edgeLength * edgeLength),
+		offset(edgeLength > 0 ? minHeight : 0.0f),
+		scale(edgeLength > 0 ? max(maxHeight - minHeight, FLT_EPSILON) / UINT16_MAX : 1.0f)
+	{
+	}
+
+	void QuantizedHeightMap::decode(vector<vector<float>>& heightMap) const
+	{
+		heightMap.resize(edgeLength);
+		for (unsigned int x = 0; x < edgeLength; x++)
+		{
+			heightMap[x].resize(edgeLength);
+			decodeRow(x, heightMap[x].data());
+		}
+	}
+
+	void QuantizedHeightMap::decodeRow(unsigned int x, float* rowHeights) const
+	{
+		const uint16_t* row = &heights[x * edgeLength];
+		unsigned int z = 0;
+
+#if (defined(__SSE2__) || defined(_M_X64)) && !defined(THE_ISLAND_SCALAR)
+		__m128 offsets = _mm_set1_ps(offset);
+		__m128 scales = _mm_set1_ps(scale);
+		__m128i zero = _mm_setzero_si128();
+
+		for (; z + 8 <= edgeLength; z += 8)
+		{
+			__m128i values = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + z));
+			__m128 low = _mm_cvtepi32_ps(_mm_unpacklo_epi16(values, zero));
+			__m128 high = _mm_cvtepi32_ps(_mm_unpackhi_epi16(values, zero));
+
+			_mm_storeu_ps(rowHeights + z, _mm_add_ps(_mm_mul_ps(low, scales), offsets));
+			_mm_storeu_ps(rowHeights + z + 4, _mm_add_ps(_mm_mul_ps(high, scales), offsets));
+		}
+#endif
+
+		for (; z < edgeLength; z++)
+		{
+			rowHeights[z] = offset + row[z] * scale;
+		}
+	}
+
+	void QuantizedHeightMap::encodeRow(unsigned int x, const float* rowHeights)
+	{
+		uint16_t* row = &heights[x * edgeLength];
+		for (unsigned int z = 0; z < edgeLength; z++)
+		{
+			row[z] = static_cast<uint16_t>((rowHeights[z] - offset) / scale + 0.5f);
+		}
+	}
+
+	unsigned int QuantizedHeightMap::getEdgeLength() const
+	{
+		return edgeLength;
+	}
+
+	float QuantizedHeightMap::getHeight(unsigned int x, unsigned int z) const
+	{
+		return offset + heights[x * edgeLength + z] * scale;
+	}
+
+	float QuantizedHeightMap::getHeight(float x, float z) const
+	{
+		if (edgeLength == 0)
+		{
+			return 0.0f;
+		}
+
+		float maxCoordinate = static_cast<float>(edgeLength - 1);
+		x = min(max(x, 0.0f), maxCoordinate);
+		z = min(max(z, 0.0f), maxCoordinate);
+
+		unsigned int x0 = min(static_cast<unsigned int>(x), edgeLength - 1);
+		unsigned int z0 = min(static_cast<unsigned int>(z), edgeLength - 1);
+		unsigned int x1 = min(x0 + 1, edgeLength - 1);
+		unsigned int z1 = min(z0 + 1, edgeLength - 1);
+		float xFraction = x - x0;
+		float zFraction = z - z0;
+
+		float height0 = getHeight(x0, z0) * (1.0f - zFraction) + getHeight(x0, z1) * zFraction;
+		float height1 = getHeight(x1, z0) * (1.0f - zFraction) + getHeight(x1, z1) * zFraction;
+
+		return height0 * (1.0f - xFraction) + height1 * xFraction;
+	}
+
+	bool QuantizedHeightMap::load(istream& stream)
+	{
+		uint32_t magic = 0;
+		uint32_t streamEdgeLength = 0;
+		float streamOffset = 0.0f;
+		float streamScale = 0.0f;
+
+		stream.read(reinterpret_cast<char*>(&magic), sizeof(magic));
+		stream.read(reinterpret_cast<char*>(&streamEdgeLength), sizeof(streamEdgeLength));
+		stream.read(reinterpret_cast<char*>(&streamOffset), sizeof(streamOffset));
+		stream.read(reinterpret_cast<char*>(&streamScale), sizeof(streamScale));
+		if (!stream || magic != MAGIC)
+		{
+			return false;
+		}
+
+		vector<uint16_t> streamHeights(streamEdgeLength * streamEdgeLength);
+		stream.read(reinterpret_cast<char*>(streamHeights.data()), streamHeights.size() * sizeof(uint16_t));
+		if (!stream)
+		{
+			return false;
+		}
+
+		edgeLength = streamEdgeLength;
+		heights.swap(streamHeights);
+		offset = streamOffset;
+		scale = streamScale;
+
+		return true;
+	}
+
+	void QuantizedHeightMap::save(ostream& stream) const
+	{
+		uint32_t streamEdgeLength = edgeLength;
+
+		stream.write(reinterpret_cast<const char*>(&MAGIC), sizeof(MAGIC));
+		stream.write(reinterpret_cast<const char*>(&streamEdgeLength), sizeof(streamEdgeLength));
+		stream.write(reinterpret_cast<const char*>(&offset), sizeof(offset));
+		stream.write(reinterpret_cast<const char*>(&scale), sizeof(scale));
+		stream.write(reinterpret_cast<const char*>(heights.data()), heights.size() * sizeof(uint16_t));
+	}
+}
@@ -0,0 +1,76 @@
+/*
+ * Copyright © 2014 Simple Entertainment Limited
+ *
+ * This file is part of The Island.
+ *
+ * The Island is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * The Island is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with The Island. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#ifndef QUANTIZEDHEIGHTMAP_H_
+#define QUANTIZEDHEIGHTMAP_H_
+
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+#include <simplicity/API.h>
+
+namespace theisland
+{
+	/**
+	 * <p>
+	 * A height map stored as 16 bit fixed point heights (height = offset + value * scale), half the size of a float
+	 * height map.
+	 * </p>
+	 */
+	class SIMPLE_API QuantizedHeightMap
+	{
+		public:
+			QuantizedHeightMap();
+
+			QuantizedHeightMap(const std::vector<std::vector<float>>& heightMap);
+
+			// An empty height map that can be encoded row by row, heights must be within the given range.
+			QuantizedHeightMap(unsigned int edgeLength, float minHeight, float maxHeight);
+
+			// Decodes the whole height map.
+			void decode(std::vector<std::vector<float>>& heightMap) const;
+
+			// Decodes one row (all the heights with the same x coordinate).
+			void decodeRow(unsigned int x, float* heights) const;
+
+			// Encodes one row (all the heights with the same x coordinate).
+			void encodeRow(unsigned int x, const float* heights);
+
+			unsigned int getEdgeLength() const;
+
+			float getHeight(unsigned int x, unsigned int z) const;
+
+			// Interpolates the height between the surrounding height map coordinates (clamped to the height map).
+			float getHeight(float x, float z) const;
+
+			// Returns false if the stream does not contain a height map.
+			bool load(std::istream& stream);
+
+			void save(std::ostream& stream) const;
+
+		private:
+			unsigned int edgeLength;
+
+			std::vector<std::uint16_t> heights;
+
+			float offset;
+
+			float scale;
+	};
+}
+
+#endif /* QUANTIZEDHEIGHTMAP_H_ */
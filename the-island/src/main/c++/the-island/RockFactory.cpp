@@ -14,6 +14,13 @@
  * You should have received a copy of the GNU General Public License along with The Island. If not, see
  * <http://www.gnu.org/licenses/>.
  */
+#include <random>
+
+#if (defined(__SSE2__) || defined(_M_X64)) && !defined(THE_ISLAND_SCALAR)
+#include <emmintrin.h>
+#endif
+
+#include "EntityCategories.h"
 #include "RockFactory.h"
 
 using namespace simplicity;
@@ -23,31 +30,85 @@ namespace theisland
 {
 	namespace RockFactory
 	{
-		void createRock(const Vector3& position, shared_ptr<MeshBuffer> buffer, float radius, unsigned int detail)
+		const unsigned int QUAD_COUNT = DETAIL * DETAIL;
+
+		float deform(MeshData& meshData, unsigned int detail);
+		float deformQuads(Vertex* vertexData, float radius, mt19937& random);
+		void loadSphere(unsigned int detail);
+		void stageRock(StagingBuffer& staging, const Vector3& position, float radius, mt19937& random,
+				unique_ptr<Entity>& rock, CollisionProxy& proxy);
+
+		// The corners of the quads of the unit sphere with one array per corner and axis so that neighbouring quads
+		// can be deformed together.
+		float cornersX[4][QUAD_COUNT];
+		float cornersY[4][QUAD_COUNT];
+		float cornersZ[4][QUAD_COUNT];
+
+		vector<unsigned int> sphereIndices;
+		unsigned int sphereDetail = 0;
+		vector<Vertex> sphereVertices;
+
+		CollisionProxy createRock(const Vector3& position, shared_ptr<MeshBuffer> buffer, float radius,
+				unsigned int detail)
 		{
 			unique_ptr<Mesh> mesh = ModelFactory::getInstance()->createSphereMesh(radius, detail, buffer,
 					Vector4(0.6f, 0.6f, 0.6f, 1.0f), false);
 			MeshData& meshData = mesh->getData(false);
 
-			float variance[detail][detail];
-			for (unsigned int latitude = 0; latitude < detail; latitude++)
+			float maxVariance = deform(meshData, detail);
+
+			unique_ptr<Model> bounds = ModelFunctions::getCircleBoundsXZ(meshData.vertexData, meshData.vertexCount);
+
+			mesh->releaseData();
+
+			unique_ptr<Entity> rock(new Entity(EntityCategories::FOLIAGE_ROCK));
+			setPosition(rock->getTransform(), position);
+			rock->addUniqueComponent(move(mesh));
+			rock->addUniqueComponent(move(bounds));
+			EntityCategories::registerEntity(*rock);
+			Simplicity::getScene()->addEntity(move(rock));
+
+			CollisionProxy proxy;
+			proxy.height = 0.0f;
+			proxy.position = position;
+			proxy.radius = radius * maxVariance;
+
+			return proxy;
+		}
+
+		void createRocks(const Vector3* positions, const float* radii, unsigned int count, mt19937& random,
+				StagingBuffer& staging, unique_ptr<Entity>* rocks, CollisionProxy* proxies)
+		{
+			reserveRocks(count, staging);
+
+			for (unsigned int index = 0; index < count; index++)
 			{
-				for (unsigned int longitude = 0; longitude < detail; longitude++)
-				{
-					variance[latitude][longitude] = getRandomFloat(0.75f, 1.25f);
-				}
+				stageRock(staging, positions[index], radii[index], random, rocks[index], proxies[index]);
+			}
+		}
+
+		float deform(MeshData& meshData, unsigned int detail)
+		{
+			vector<float> variance(detail * detail);
+			float maxVariance = 0.0f;
+			for (float& segmentVariance : variance)
+			{
+				segmentVariance = getRandomFloat(0.75f, 1.25f);
+				maxVariance = max(maxVariance, segmentVariance);
 			}
 
 			for (unsigned int latitude = 0; latitude < detail; latitude++)
 			{
+				unsigned int nextLatitude = (latitude + 1) % detail;
 				for (unsigned int longitude = 0; longitude < detail; longitude++)
 				{
+					unsigned int nextLongitude = (longitude + 1) % detail;
 					unsigned int segmentIndex = (latitude * detail + longitude) * 4;
 
-					meshData.vertexData[segmentIndex].position *= variance[latitude][longitude];
-					meshData.vertexData[segmentIndex + 1].position *= variance[(latitude + 1) % detail][longitude];
-					meshData.vertexData[segmentIndex + 2].position *= variance[(latitude + 1) % detail][(longitude + 1) % detail];
-					meshData.vertexData[segmentIndex + 3].position *= variance[latitude][(longitude + 1) % detail];
+					meshData.vertexData[segmentIndex].position *= variance[latitude * detail + longitude];
+					meshData.vertexData[segmentIndex + 1].position *= variance[nextLatitude * detail + longitude];
+					meshData.vertexData[segmentIndex + 2].position *= variance[nextLatitude * detail + nextLongitude];
+					meshData.vertexData[segmentIndex + 3].position *= variance[latitude * detail + nextLongitude];
 
 					Vector3 edge0 = meshData.vertexData[segmentIndex + 1].position -
 							meshData.vertexData[segmentIndex].position;
@@ -63,15 +124,190 @@ namespace theisland
 				}
 			}
 
-			unique_ptr<Model> bounds = ModelFunctions::getCircleBoundsXZ(meshData.vertexData, meshData.vertexCount);
+			return maxVariance;
+		}
 
-			mesh->releaseData();
+		float deformQuads(Vertex* vertexData, float radius, mt19937& random)
+		{
+			uniform_real_distribution<float> varianceDistribution(0.75f, 1.25f);
+
+			float variance[DETAIL][DETAIL];
+			float maxVariance = 0.0f;
+			for (unsigned int latitude = 0; latitude < DETAIL; latitude++)
+			{
+				for (unsigned int longitude = 0; longitude < DETAIL; longitude++)
+				{
+					variance[latitude][longitude] = varianceDistribution(random);
+					maxVariance = max(maxVariance, variance[latitude][longitude]);
+				}
+			}
+
+			// The scale of each corner of each quad.
+			float scales[4][QUAD_COUNT];
+			for (unsigned int latitude = 0; latitude < DETAIL; latitude++)
+			{
+				unsigned int nextLatitude = (latitude + 1) % DETAIL;
+				for (unsigned int longitude = 0; longitude < DETAIL; longitude++)
+				{
+					unsigned int nextLongitude = (longitude + 1) % DETAIL;
+					unsigned int quad = latitude * DETAIL + longitude;
 
-			unique_ptr<Entity> rock(new Entity);
+					scales[0][quad] = variance[latitude][longitude] * radius;
+					scales[1][quad] = variance[nextLatitude][longitude] * radius;
+					scales[2][quad] = variance[nextLatitude][nextLongitude] * radius;
+					scales[3][quad] = variance[latitude][nextLongitude] * radius;
+				}
+			}
+
+			float positionsX[4][QUAD_COUNT];
+			float positionsY[4][QUAD_COUNT];
+			float positionsZ[4][QUAD_COUNT];
+			float normalsX[QUAD_COUNT];
+			float normalsY[QUAD_COUNT];
+			float normalsZ[QUAD_COUNT];
+			unsigned int quad = 0;
+
+#if (defined(__SSE2__) || defined(_M_X64)) && !defined(THE_ISLAND_SCALAR)
+			for (; quad + 4 <= QUAD_COUNT; quad += 4)
+			{
+				__m128 x[4];
+				__m128 y[4];
+				__m128 z[4];
+				for (unsigned int corner = 0; corner < 4; corner++)
+				{
+					__m128 scale = _mm_loadu_ps(&scales[corner][quad]);
+					x[corner] = _mm_mul_ps(_mm_loadu_ps(&cornersX[corner][quad]), scale);
+					y[corner] = _mm_mul_ps(_mm_loadu_ps(&cornersY[corner][quad]), scale);
+					z[corner] = _mm_mul_ps(_mm_loadu_ps(&cornersZ[corner][quad]), scale);
+					_mm_storeu_ps(&positionsX[corner][quad], x[corner]);
+					_mm_storeu_ps(&positionsY[corner][quad], y[corner]);
+					_mm_storeu_ps(&positionsZ[corner][quad], z[corner]);
+				}
+
+				__m128 edge0X = _mm_sub_ps(x[1], x[0]);
+				__m128 edge0Y = _mm_sub_ps(y[1], y[0]);
+				__m128 edge0Z = _mm_sub_ps(z[1], z[0]);
+				__m128 edge1X = _mm_sub_ps(x[2], x[0]);
+				__m128 edge1Y = _mm_sub_ps(y[2], y[0]);
+				__m128 edge1Z = _mm_sub_ps(z[2], z[0]);
+
+				__m128 normalX = _mm_sub_ps(_mm_mul_ps(edge0Y, edge1Z), _mm_mul_ps(edge0Z, edge1Y));
+				__m128 normalY = _mm_sub_ps(_mm_mul_ps(edge0Z, edge1X), _mm_mul_ps(edge0X, edge1Z));
+				__m128 normalZ = _mm_sub_ps(_mm_mul_ps(edge0X, edge1Y), _mm_mul_ps(edge0Y, edge1X));
+				__m128 magnitude = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(normalX, normalX),
+						_mm_mul_ps(normalY, normalY)), _mm_mul_ps(normalZ, normalZ)));
+
+				_mm_storeu_ps(&normalsX[quad], _mm_div_ps(normalX, magnitude));
+				_mm_storeu_ps(&normalsY[quad], _mm_div_ps(normalY, magnitude));
+				_mm_storeu_ps(&normalsZ[quad], _mm_div_ps(normalZ, magnitude));
+			}
+#endif
+
+			for (; quad < QUAD_COUNT; quad++)
+			{
+				for (unsigned int corner = 0; corner < 4; corner++)
+				{
+					positionsX[corner][quad] = cornersX[corner][quad] * scales[corner][quad];
+					positionsY[corner][quad] = cornersY[corner][quad] * scales[corner][quad];
+					positionsZ[corner][quad] = cornersZ[corner][quad] * scales[corner][quad];
+				}
+
+				float edge0X = positionsX[1][quad] - positionsX[0][quad];
+				float edge0Y = positionsY[1][quad] - positionsY[0][quad];
+				float edge0Z = positionsZ[1][quad] - positionsZ[0][quad];
+				float edge1X = positionsX[2][quad] - positionsX[0][quad];
+				float edge1Y = positionsY[2][quad] - positionsY[0][quad];
+				float edge1Z = positionsZ[2][quad] - positionsZ[0][quad];
+
+				float normalX = edge0Y * edge1Z - edge0Z * edge1Y;
+				float normalY = edge0Z * edge1X - edge0X * edge1Z;
+				float normalZ = edge0X * edge1Y - edge0Y * edge1X;
+				float magnitude = sqrt(normalX * normalX + normalY * normalY + normalZ * normalZ);
+
+				normalsX[quad] = normalX / magnitude;
+				normalsY[quad] = normalY / magnitude;
+				normalsZ[quad] = normalZ / magnitude;
+			}
+
+			for (quad = 0; quad < QUAD_COUNT; quad++)
+			{
+				Vector3 normal(normalsX[quad], normalsY[quad], normalsZ[quad]);
+				for (unsigned int corner = 0; corner < 4; corner++)
+				{
+					Vertex& vertex = vertexData[quad * 4 + corner];
+					vertex.normal = normal;
+					vertex.position = Vector3(positionsX[corner][quad], positionsY[corner][quad],
+							positionsZ[corner][quad]);
+				}
+			}
+
+			return maxVariance;
+		}
+
+		void loadSphere(unsigned int detail)
+		{
+			// The sphere is only mapped once (per detail) and then copied into the staging buffer for every rock.
+			if (sphereDetail == detail)
+			{
+				return;
+			}
+
+			unique_ptr<Mesh> sphere = ModelFactory::getInstance()->createSphereMesh(1.0f, detail,
+					shared_ptr<MeshBuffer>(), Vector4(0.6f, 0.6f, 0.6f, 1.0f), false);
+			const MeshData& sphereData = sphere->getData();
+			sphereIndices.assign(sphereData.indexData, sphereData.indexData + sphereData.indexCount);
+			sphereVertices.assign(sphereData.vertexData, sphereData.vertexData + sphereData.vertexCount);
+			sphere->releaseData();
+
+			sphereDetail = detail;
+
+			if (detail == DETAIL)
+			{
+				for (unsigned int quad = 0; quad < QUAD_COUNT; quad++)
+				{
+					for (unsigned int corner = 0; corner < 4; corner++)
+					{
+						const Vector3& position = sphereVertices[quad * 4 + corner].position;
+						cornersX[corner][quad] = position.X();
+						cornersY[corner][quad] = position.Y();
+						cornersZ[corner][quad] = position.Z();
+					}
+				}
+			}
+		}
+
+		void reserveRocks(unsigned int count, StagingBuffer& staging)
+		{
+			loadSphere(DETAIL);
+			staging.reserve(sphereVertices.size() * count, sphereIndices.size() * count);
+		}
+
+		void stageRock(StagingBuffer& staging, const Vector3& position, float radius, mt19937& random,
+				unique_ptr<Entity>& rock, CollisionProxy& proxy)
+		{
+			loadSphere(DETAIL);
+
+			MeshData& meshData = staging.stage(sphereVertices.size(), sphereIndices.size());
+			meshData.indexCount = sphereIndices.size();
+			meshData.vertexCount = sphereVertices.size();
+			memcpy(meshData.indexData, sphereIndices.data(), sphereIndices.size() * sizeof(unsigned int));
+			memcpy(meshData.vertexData, sphereVertices.data(), sphereVertices.size() * sizeof(Vertex));
+
+			// Any vertices beyond the quads are only scaled.
+			for (unsigned int vertexIndex = QUAD_COUNT * 4; vertexIndex < meshData.vertexCount; vertexIndex++)
+			{
+				meshData.vertexData[vertexIndex].position *= radius;
+			}
+
+			float maxVariance = deformQuads(meshData.vertexData, radius, random);
+
+			rock.reset(new Entity(EntityCategories::FOLIAGE_ROCK));
 			setPosition(rock->getTransform(), position);
-			rock->addUniqueComponent(move(mesh));
-			rock->addUniqueComponent(move(bounds));
-			Simplicity::getScene()->addEntity(move(rock));
+			rock->addUniqueComponent(ModelFunctions::getCircleBoundsXZ(meshData.vertexData, meshData.vertexCount));
+
+			proxy.height = 0.0f;
+			proxy.position = position;
+			proxy.radius = radius * maxVariance;
 		}
 	}
 }
@@ -18,15 +18,32 @@
 #define ROCKFACTORY_H_
 
 #include <memory>
+#include <random>
 
 #include <simplicity/API.h>
 
+#include "CollisionProxy.h"
+#include "StagingBuffer.h"
+
 namespace theisland
 {
 	namespace RockFactory
 	{
-		SIMPLE_API void createRock(const simplicity::Vector3& position, std::shared_ptr<simplicity::MeshBuffer> buffer,
-				float radius, unsigned int detail);
+		// The detail of the rocks created together, their deformation is specialised for it.
+		const unsigned int DETAIL = 10;
+
+		SIMPLE_API CollisionProxy createRock(const simplicity::Vector3& position,
+				std::shared_ptr<simplicity::MeshBuffer> buffer, float radius, unsigned int detail);
+
+		// Stages the meshes of a number of rocks one after the other instead of creating them. The rocks are not added
+		// to the scene, the meshes uploaded from the staging buffer have to be added to them first. Staging the rocks
+		// in batches with the same random numbers gives the same rocks as staging them together.
+		SIMPLE_API void createRocks(const simplicity::Vector3* positions, const float* radii, unsigned int count,
+				std::mt19937& random, StagingBuffer& staging, std::unique_ptr<simplicity::Entity>* rocks,
+				CollisionProxy* proxies);
+
+		// Makes room in the staging buffer for a number of rocks, for hosts that stage them in batches.
+		SIMPLE_API void reserveRocks(unsigned int count, StagingBuffer& staging);
 	}
 }
 
@@ -0,0 +1,92 @@
+/*
+ * Copyright © 2014 Simple Entertainment Limited
+ *
+ * This file is part of The Island.
+ *
+ * The Island is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * The Island is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with The Island. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <algorithm>
+
+#include "EntityCategories.h"
+#include "SceneBatch.h"
+
+using namespace simplicity;
+using namespace std;
+
+namespace theisland
+{
+	SceneBatch::SceneBatch() :
+		committedCount(0),
+		entities(),
+		parents()
+	{
+	}
+
+	void SceneBatch::add(unique_ptr<Entity> entity, Entity* parent)
+	{
+		entities.push_back(move(entity));
+		parents.push_back(parent);
+	}
+
+	void SceneBatch::commit()
+	{
+		vector<Entity*> roots;
+		commit(roots);
+	}
+
+	void SceneBatch::commit(vector<Entity*>& roots)
+	{
+		commit(getSize(), roots);
+	}
+
+	bool SceneBatch::commit(unsigned int count, vector<Entity*>& roots)
+	{
+		Scene* scene = Simplicity::getScene();
+		unsigned int end = committedCount + min(count, getSize());
+		for (; committedCount < end; committedCount++)
+		{
+			EntityCategories::registerEntity(*entities[committedCount]);
+
+			if (parents[committedCount] == nullptr)
+			{
+				roots.push_back(entities[committedCount].get());
+				scene->addEntity(move(entities[committedCount]));
+			}
+			else
+			{
+				scene->addEntity(move(entities[committedCount]), *parents[committedCount]);
+			}
+		}
+
+		if (committedCount < entities.size())
+		{
+			return false;
+		}
+
+		committedCount = 0;
+		entities.clear();
+		parents.clear();
+
+		return true;
+	}
+
+	unsigned int SceneBatch::getSize() const
+	{
+		return entities.size() - committedCount;
+	}
+
+	void SceneBatch::reserve(unsigned int entityCount)
+	{
+		entities.reserve(entityCount);
+		parents.reserve(entityCount);
+	}
+}
@@ -0,0 +1,64 @@
+/*
+ * Copyright © 2014 Simple Entertainment Limited
+ *
+ * This file is part of The Island.
+ *
+ * The Island is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * The Island is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with The Island. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#ifndef SCENEBATCH_H_
+#define SCENEBATCH_H_
+
+#include <memory>
+#include <vector>
+
+#include <simplicity/API.h>
+
+namespace theisland
+{
+	/**
+	 * <p>
+	 * Collects generated entities so that they can be added to the scene together once they are complete.
+	 * </p>
+	 */
+	class SIMPLE_API SceneBatch
+	{
+		public:
+			SceneBatch();
+
+			// The parent must already be in the scene or have been added to the batch before the entity.
+			void add(std::unique_ptr<simplicity::Entity> entity, simplicity::Entity* parent = nullptr);
+
+			// Adds all the entities to the scene in the order they were added to the batch and empties the batch.
+			void commit();
+
+			// As above, appending the entities added without a parent to the roots.
+			void commit(std::vector<simplicity::Entity*>& roots);
+
+			// As above but only adds up to the given number of entities, carrying on from where the last call left off,
+			// for hosts that cannot add them all at once. Returns true once all the entities have been added.
+			bool commit(unsigned int count, std::vector<simplicity::Entity*>& roots);
+
+			// The number of entities that have not been added to the scene yet.
+			unsigned int getSize() const;
+
+			void reserve(unsigned int entityCount);
+
+		private:
+			unsigned int committedCount;
+
+			std::vector<std::unique_ptr<simplicity::Entity>> entities;
+
+			std::vector<simplicity::Entity*> parents;
+	};
+}
+
+#endif /* SCENEBATCH_H_ */
@@ -0,0 +1,90 @@
+/*
+ * Copyright © 2014 Simple Entertainment Limited
+ *
+ * This file is part of The Island.
+ *
+ * The Island is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * The Island is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with The Island. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include "SpatialHash.h"
+
+using namespace simplicity;
+using namespace std;
+
+namespace theisland
+{
+	SpatialHash::SpatialHash(float minX, float minZ, float size, float cellSize) :
+		cells(),
+		cellsPerEdge(max(1u, static_cast<unsigned int>(ceil(size / cellSize)))),
+		cellSize(cellSize),
+		minX(minX),
+		minZ(minZ)
+	{
+		cells.resize(cellsPerEdge * cellsPerEdge);
+	}
+
+	void SpatialHash::add(const Vector3& position, float radius)
+	{
+		unsigned int cellX;
+		unsigned int cellZ;
+		getCell(position.X(), position.Z(), cellX, cellZ);
+
+		Circle circle;
+		circle.radius = radius;
+		circle.x = position.X();
+		circle.z = position.Z();
+		cells[cellX * cellsPerEdge + cellZ].push_back(circle);
+	}
+
+	void SpatialHash::getCell(float x, float z, unsigned int& cellX, unsigned int& cellZ) const
+	{
+		float maxCell = static_cast<float>(cellsPerEdge - 1);
+		cellX = static_cast<unsigned int>(min(max((x - minX) / cellSize, 0.0f), maxCell));
+		cellZ = static_cast<unsigned int>(min(max((z - minZ) / cellSize, 0.0f), maxCell));
+	}
+
+	float SpatialHash::getCellSize() const
+	{
+		return cellSize;
+	}
+
+	bool SpatialHash::isFree(const Vector3& position, float radius) const
+	{
+		unsigned int cellX;
+		unsigned int cellZ;
+		getCell(position.X(), position.Z(), cellX, cellZ);
+
+		unsigned int minCellX = cellX > 0 ? cellX - 1 : cellX;
+		unsigned int maxCellX = min(cellX + 1, cellsPerEdge - 1);
+		unsigned int minCellZ = cellZ > 0 ? cellZ - 1 : cellZ;
+		unsigned int maxCellZ = min(cellZ + 1, cellsPerEdge - 1);
+
+		for (unsigned int x = minCellX; x <= maxCellX; x++)
+		{
+			for (unsigned int z = minCellZ; z <= maxCellZ; z++)
+			{
+				for (const Circle& circle : cells[x * cellsPerEdge + z])
+				{
+					float distanceX = circle.x - position.X();
+					float distanceZ = circle.z - position.Z();
+					float minDistance = circle.radius + radius;
+
+					if (distanceX * distanceX + distanceZ * distanceZ < minDistance * minDistance)
+					{
+						return false;
+					}
+				}
+			}
+		}
+
+		return true;
+	}
+}
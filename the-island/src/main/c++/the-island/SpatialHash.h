@@ -0,0 +1,68 @@
+/*
+ * Copyright © 2014 Simple Entertainment Limited
+ *
+ * This file is part of The Island.
+ *
+ * The Island is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * The Island is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with The Island. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#ifndef SPATIALHASH_H_
+#define SPATIALHASH_H_
+
+#include <vector>
+
+#include <simplicity/API.h>
+
+namespace theisland
+{
+	/**
+	 * <p>
+	 * A uniform grid of circles on the XZ plane for finding out quickly whether a new circle would overlap any of
+	 * them. The cells must be at least as wide as the largest circle so that only the neighbouring cells need to be
+	 * searched.
+	 * </p>
+	 */
+	class SIMPLE_API SpatialHash
+	{
+		public:
+			SpatialHash(float minX, float minZ, float size, float cellSize);
+
+			void add(const simplicity::Vector3& position, float radius);
+
+			float getCellSize() const;
+
+			bool isFree(const simplicity::Vector3& position, float radius) const;
+
+		private:
+			struct Circle
+			{
+				float radius;
+
+				float x;
+
+				float z;
+			};
+
+			std::vector<std::vector<Circle>> cells;
+
+			unsigned int cellsPerEdge;
+
+			float cellSize;
+
+			float minX;
+
+			float minZ;
+
+			void getCell(float x, float z, unsigned int& cellX, unsigned int& cellZ) const;
+	};
+}
+
+#endif /* SPATIALHASH_H_ */
@@ -0,0 +1,161 @@
+/*
+ * Copyright © 2014 Simple Entertainment Limited
+ *
+ * This file is part of The Island.
+ *
+ * The Island is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * The Island is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with The Island. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include "StagingBuffer.h"
+
+using namespace simplicity;
+using namespace std;
+
+namespace theisland
+{
+	StagingBuffer::StagingBuffer() :
+		indices(),
+		meshes(),
+		vertices()
+	{
+	}
+
+	void StagingBuffer::clear()
+	{
+		indices.clear();
+		meshes.clear();
+		vertices.clear();
+	}
+
+	shared_ptr<MeshBuffer> StagingBuffer::createBuffer(Buffer::AccessHint accessHint) const
+	{
+		return ModelFactory::getInstance()->createMeshBuffer(getVertexCount(), getIndexCount(), accessHint);
+	}
+
+	MeshData& StagingBuffer::getData(unsigned int mesh)
+	{
+		// The vectors may have been reallocated since the mesh was staged.
+		StagedMesh& stagedMesh = meshes[mesh];
+		stagedMesh.data.indexData = indices.data() + stagedMesh.indexOffset;
+		stagedMesh.data.vertexData = vertices.data() + stagedMesh.vertexOffset;
+
+		return stagedMesh.data;
+	}
+
+	unsigned int StagingBuffer::getIndexCount() const
+	{
+		unsigned int indexCount = 0;
+		for (const StagedMesh& mesh : meshes)
+		{
+			indexCount += mesh.data.indexCount;
+		}
+
+		return indexCount;
+	}
+
+	unsigned int StagingBuffer::getMeshCount() const
+	{
+		return meshes.size();
+	}
+
+	unsigned int StagingBuffer::getVertexCount() const
+	{
+		unsigned int vertexCount = 0;
+		for (const StagedMesh& mesh : meshes)
+		{
+			vertexCount += mesh.data.vertexCount;
+		}
+
+		return vertexCount;
+	}
+
+	MeshData& StagingBuffer::grow(unsigned int maxVertexCount, unsigned int maxIndexCount)
+	{
+		const StagedMesh& mesh = meshes.back();
+		indices.resize(max<size_t>(indices.size(), mesh.indexOffset + maxIndexCount));
+		vertices.resize(max<size_t>(vertices.size(), mesh.vertexOffset + maxVertexCount));
+
+		return getData(meshes.size() - 1);
+	}
+
+	void StagingBuffer::reserve(unsigned int vertexCount, unsigned int indexCount)
+	{
+		indices.reserve(indices.size() + indexCount);
+		vertices.reserve(vertices.size() + vertexCount);
+	}
+
+	MeshData& StagingBuffer::stage(unsigned int maxVertexCount, unsigned int maxIndexCount)
+	{
+		if (!meshes.empty())
+		{
+			const StagedMesh& previous = meshes.back();
+			indices.resize(previous.indexOffset + previous.data.indexCount);
+			vertices.resize(previous.vertexOffset + previous.data.vertexCount);
+		}
+
+		StagedMesh mesh;
+		mesh.data.indexCount = 0;
+		mesh.data.vertexCount = 0;
+		mesh.indexOffset = indices.size();
+		mesh.vertexOffset = vertices.size();
+		meshes.push_back(mesh);
+
+		indices.resize(indices.size() + maxIndexCount);
+		vertices.resize(vertices.size() + maxVertexCount);
+
+		return getData(meshes.size() - 1);
+	}
+
+	void StagingBuffer::unstage()
+	{
+		const StagedMesh& last = meshes.back();
+		indices.resize(last.indexOffset);
+		vertices.resize(last.vertexOffset);
+
+		meshes.pop_back();
+	}
+
+	vector<unique_ptr<Mesh>> StagingBuffer::upload(Buffer::AccessHint accessHint)
+	{
+		vector<unique_ptr<Mesh>> uploadedMeshes;
+		if (meshes.empty())
+		{
+			return move(uploadedMeshes);
+		}
+
+		shared_ptr<MeshBuffer> buffer = createBuffer(accessHint);
+
+		uploadedMeshes.reserve(meshes.size());
+		for (unsigned int index = 0; index < meshes.size(); index++)
+		{
+			uploadedMeshes.push_back(upload(index, buffer));
+		}
+
+		return move(uploadedMeshes);
+	}
+
+	unique_ptr<Mesh> StagingBuffer::upload(unsigned int mesh, shared_ptr<MeshBuffer> buffer)
+	{
+		const MeshData& stagedData = getData(mesh);
+
+		unique_ptr<Mesh> uploadedMesh(new Mesh(buffer));
+		MeshData& meshData = uploadedMesh->getData(false);
+
+		meshData.indexCount = stagedData.indexCount;
+		meshData.vertexCount = stagedData.vertexCount;
+		memcpy(meshData.indexData, stagedData.indexData, stagedData.indexCount * sizeof(unsigned int));
+		memcpy(meshData.vertexData, stagedData.vertexData, stagedData.vertexCount * sizeof(Vertex));
+
+		uploadedMesh->releaseData();
+
+		return move(uploadedMesh);
+	}
+}
@@ -0,0 +1,94 @@
+/*
+ * Copyright © 2014 Simple Entertainment Limited
+ *
+ * This file is part of The Island.
+ *
+ * The Island is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * The Island is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with The Island. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#ifndef STAGINGBUFFER_H_
+#define STAGINGBUFFER_H_
+
+#include <memory>
+#include <vector>
+
+#include <simplicity/API.h>
+
+namespace theisland
+{
+	/**
+	 * <p>
+	 * Builds meshes in memory so that they can be read and written freely and then uploads them all into one mesh
+	 * buffer, mapping each mesh only once to write it.
+	 * </p>
+	 */
+	class SIMPLE_API StagingBuffer
+	{
+		public:
+			StagingBuffer();
+
+			void clear();
+
+			// A new mesh buffer that fits the staged meshes exactly, for uploading them one at a time. Meshes that
+			// bodies are created from need to be readable.
+			std::shared_ptr<simplicity::MeshBuffer> createBuffer(simplicity::Buffer::AccessHint accessHint) const;
+
+			// The data of a staged mesh. Only the data of the last mesh staged can be grown and it is only valid until
+			// the next mesh is staged.
+			simplicity::MeshData& getData(unsigned int mesh);
+
+			unsigned int getIndexCount() const;
+
+			unsigned int getMeshCount() const;
+
+			unsigned int getVertexCount() const;
+
+			// Gives the last mesh staged room for at least the given number of vertices and indices and returns its
+			// data, which may have moved.
+			simplicity::MeshData& grow(unsigned int maxVertexCount, unsigned int maxIndexCount);
+
+			// Makes room for meshes with the given total number of vertices and indices so that staging them does not
+			// move the data of the meshes staged before them.
+			void reserve(unsigned int vertexCount, unsigned int indexCount);
+
+			// Stages an empty mesh with room for the given number of vertices and indices and returns its data. The
+			// room left over in the previous mesh is given back.
+			simplicity::MeshData& stage(unsigned int maxVertexCount, unsigned int maxIndexCount);
+
+			// Removes the last mesh staged and gives back its room.
+			void unstage();
+
+			// Uploads the staged meshes into a new mesh buffer that fits them exactly. The meshes are returned in the
+			// order they were staged. The staged data is kept until the staging buffer is cleared.
+			std::vector<std::unique_ptr<simplicity::Mesh>> upload(simplicity::Buffer::AccessHint accessHint);
+
+			// Uploads one staged mesh into a buffer created for the staged meshes.
+			std::unique_ptr<simplicity::Mesh> upload(unsigned int mesh, std::shared_ptr<simplicity::MeshBuffer> buffer);
+
+		private:
+			struct StagedMesh
+			{
+				simplicity::MeshData data;
+
+				unsigned int indexOffset;
+
+				unsigned int vertexOffset;
+			};
+
+			std::vector<unsigned int> indices;
+
+			std::vector<StagedMesh> meshes;
+
+			std::vector<simplicity::Vertex> vertices;
+	};
+}
+
+#endif /* STAGINGBUFFER_H_ */
@@ -0,0 +1,305 @@
+/*
+ * Copyright © 2014 Simple Entertainment Limited
+ *
+ * This file is part of The Island.
+ *
+ * The Island is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * The Island is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with The Island. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <algorithm>
+#include <cmath>
+#include <future>
+#include <thread>
+
+#if (defined(__SSE2__) || defined(_M_X64)) && !defined(THE_ISLAND_SCALAR)
+#include <emmintrin.h>
+#endif
+
+#include "TerrainLighting.h"
+
+using namespace simplicity;
+using namespace std;
+
+// How much higher than the sun the horizon has to be (as the tangent of its elevation) to cast a full shadow.
+static const float SHADOW_SOFTNESS = 0.1f;
+
+// The number of levels the interpolated light is rounded to.
+static const float LIGHT_LEVELS = 32.0f;
+
+namespace theisland
+{
+	namespace TerrainLighting
+	{
+		// A point along a ray through the height map.
+		struct RayStep
+		{
+			float inverseDistance;
+
+			int x;
+
+			int z;
+		};
+
+		void bakeRow(const vector<vector<float>>& heightMap, unsigned int x, const Settings& settings,
+				const vector<vector<RayStep>>& rays, const vector<RayStep>& sunRay, float sunElevation,
+				vector<float>& horizons, ArenaVector<float>& row);
+		float getHorizon(const vector<vector<float>>& heightMap, unsigned int x, unsigned int z,
+				const vector<RayStep>& ray);
+		vector<RayStep> getRay(float directionX, float directionZ, float searchDistance);
+		void getRays(const Settings& settings, vector<vector<RayStep>>& rays, vector<RayStep>& sunRay,
+				float& sunElevation);
+		void scanHorizons(const vector<vector<float>>& heightMap, unsigned int x, const vector<RayStep>& ray,
+				vector<float>& horizons);
+
+		void bake(const vector<vector<float>>& heightMap, const Settings& settings, ArenaMap& lightMap)
+		{
+			// The rows are allocated here so that the workers only write to them.
+			unsigned int edgeLength = heightMap.size();
+			lightMap.assign(edgeLength, ArenaVector<float>(edgeLength, 1.0f, lightMap.get_allocator()));
+
+			vector<vector<RayStep>> rays;
+			vector<RayStep> sunRay;
+			float sunElevation = 0.0f;
+			getRays(settings, rays, sunRay, sunElevation);
+
+			unsigned int workerCount = max(1u, thread::hardware_concurrency());
+
+			auto bakeWorkerRows = [&](unsigned int worker)
+			{
+				vector<float> horizons(edgeLength);
+				for (unsigned int x = worker; x < edgeLength; x += workerCount)
+				{
+					bakeRow(heightMap, x, settings, rays, sunRay, sunElevation, horizons, lightMap[x]);
+				}
+			};
+
+			vector<future<void>> workers;
+			for (unsigned int worker = 1; worker < workerCount; worker++)
+			{
+				workers.push_back(async(launch::async, bakeWorkerRows, worker));
+			}
+			bakeWorkerRows(0);
+
+			for (future<void>& worker : workers)
+			{
+				worker.get();
+			}
+		}
+
+		void bakeRow(const vector<vector<float>>& heightMap, unsigned int x, const Settings& settings,
+				const vector<vector<RayStep>>& rays, const vector<RayStep>& sunRay, float sunElevation,
+				vector<float>& horizons, ArenaVector<float>& row)
+		{
+			unsigned int edgeLength = heightMap.size();
+			vector<float> occlusion(edgeLength, 0.0f);
+
+			for (const vector<RayStep>& ray : rays)
+			{
+				scanHorizons(heightMap, x, ray, horizons);
+
+				// The occlusion of each direction is the sine of the elevation of its horizon.
+				for (unsigned int z = 0; z < edgeLength; z++)
+				{
+					occlusion[z] += horizons[z] / sqrt(1.0f + horizons[z] * horizons[z]);
+				}
+			}
+
+			if (!sunRay.empty())
+			{
+				scanHorizons(heightMap, x, sunRay, horizons);
+			}
+			else
+			{
+				fill(horizons.begin(), horizons.end(), 0.0f);
+			}
+
+			for (unsigned int z = 0; z < edgeLength; z++)
+			{
+				float ambient = 1.0f;
+				if (!rays.empty())
+				{
+					ambient -= settings.occlusionStrength * occlusion[z] / rays.size();
+				}
+
+				float shadow = 0.0f;
+				if (!sunRay.empty())
+				{
+					shadow = min(max((horizons[z] - sunElevation) / SHADOW_SOFTNESS, 0.0f), 1.0f);
+				}
+
+				row[z] = ambient * (1.0f - settings.shadowStrength * shadow);
+			}
+		}
+
+		void bakeRows(const vector<vector<float>>& heightMap, const Settings& settings, unsigned int minX,
+				unsigned int maxX, ArenaMap& lightMap)
+		{
+			unsigned int edgeLength = heightMap.size();
+			if (lightMap.empty())
+			{
+				lightMap.assign(edgeLength, ArenaVector<float>(edgeLength, 1.0f, lightMap.get_allocator()));
+			}
+
+			vector<vector<RayStep>> rays;
+			vector<RayStep> sunRay;
+			float sunElevation = 0.0f;
+			getRays(settings, rays, sunRay, sunElevation);
+
+			vector<float> horizons(edgeLength);
+			for (unsigned int x = minX; x < maxX; x++)
+			{
+				bakeRow(heightMap, x, settings, rays, sunRay, sunElevation, horizons, lightMap[x]);
+			}
+		}
+
+		float getHorizon(const vector<vector<float>>& heightMap, unsigned int x, unsigned int z,
+				const vector<RayStep>& ray)
+		{
+			int edgeLength = heightMap.size();
+			float height = heightMap[x][z];
+			float horizon = 0.0f;
+
+			for (const RayStep& step : ray)
+			{
+				int sampleX = x + step.x;
+				int sampleZ = z + step.z;
+				if (sampleX >= 0 && sampleX < edgeLength && sampleZ >= 0 && sampleZ < edgeLength)
+				{
+					horizon = max(horizon, (heightMap[sampleX][sampleZ] - height) * step.inverseDistance);
+				}
+			}
+
+			return horizon;
+		}
+
+		float getLight(const ArenaMap& lightMap, float x, float z)
+		{
+			if (lightMap.empty())
+			{
+				return 1.0f;
+			}
+
+			float maxCoordinate = lightMap.size() - 1;
+			x = min(max(x, 0.0f), maxCoordinate);
+			z = min(max(z, 0.0f), maxCoordinate);
+
+			unsigned int x0 = static_cast<unsigned int>(x);
+			unsigned int z0 = static_cast<unsigned int>(z);
+			unsigned int x1 = min(x0 + 1, static_cast<unsigned int>(maxCoordinate));
+			unsigned int z1 = min(z0 + 1, static_cast<unsigned int>(maxCoordinate));
+			float offsetX = x - x0;
+			float offsetZ = z - z0;
+
+			float light0 = lightMap[x0][z0] + (lightMap[x0][z1] - lightMap[x0][z0]) * offsetZ;
+			float light1 = lightMap[x1][z0] + (lightMap[x1][z1] - lightMap[x1][z0]) * offsetZ;
+
+			float light = light0 + (light1 - light0) * offsetX;
+
+			return floor(light * LIGHT_LEVELS + 0.5f) / LIGHT_LEVELS;
+		}
+
+		vector<RayStep> getRay(float directionX, float directionZ, float searchDistance)
+		{
+			// The steps get longer further out where the horizon needs less detail.
+			vector<RayStep> ray;
+			for (float distance = 1.0f; distance <= searchDistance; distance += max(1.0f, distance * 0.25f))
+			{
+				RayStep step;
+				step.x = static_cast<int>(floor(directionX * distance + 0.5f));
+				step.z = static_cast<int>(floor(directionZ * distance + 0.5f));
+				if ((step.x == 0 && step.z == 0) || (!ray.empty() && step.x == ray.back().x && step.z == ray.back().z))
+				{
+					continue;
+				}
+
+				step.inverseDistance = 1.0f / sqrt(static_cast<float>(step.x * step.x + step.z * step.z));
+				ray.push_back(step);
+			}
+
+			return ray;
+		}
+
+		void getRays(const Settings& settings, vector<vector<RayStep>>& rays, vector<RayStep>& sunRay,
+				float& sunElevation)
+		{
+			for (unsigned int direction = 0; direction < settings.directionCount; direction++)
+			{
+				float angle = MathConstants::PI * 2.0f * direction / settings.directionCount;
+				rays.push_back(getRay(cos(angle), sin(angle), settings.searchDistance));
+			}
+
+			Vector3 sunDirection = settings.sunDirection;
+			float sunDistance = sqrt(sunDirection.X() * sunDirection.X() + sunDirection.Z() * sunDirection.Z());
+			if (sunDistance > 0.0f)
+			{
+				sunRay = getRay(sunDirection.X() / sunDistance, sunDirection.Z() / sunDistance,
+						settings.searchDistance);
+				sunElevation = sunDirection.Y() / sunDistance;
+			}
+		}
+
+		void scanHorizons(const vector<vector<float>>& heightMap, unsigned int x, const vector<RayStep>& ray,
+				vector<float>& horizons)
+		{
+			int edgeLength = heightMap.size();
+			const float* row = heightMap[x].data();
+			int z = 0;
+
+#if (defined(__SSE2__) || defined(_M_X64)) && !defined(THE_ISLAND_SCALAR)
+			// Every step of the ray is the same offset for each point so four neighbouring points are scanned at once.
+			for (; z + 4 <= edgeLength; z += 4)
+			{
+				__m128 heights = _mm_loadu_ps(row + z);
+				__m128 horizon = _mm_setzero_ps();
+
+				for (const RayStep& step : ray)
+				{
+					int sampleX = x + step.x;
+					int sampleZ = z + step.z;
+					if (sampleX < 0 || sampleX >= edgeLength)
+					{
+						continue;
+					}
+
+					if (sampleZ >= 0 && sampleZ + 4 <= edgeLength)
+					{
+						__m128 samples = _mm_loadu_ps(heightMap[sampleX].data() + sampleZ);
+						horizon = _mm_max_ps(horizon, _mm_mul_ps(_mm_sub_ps(samples, heights),
+								_mm_set1_ps(step.inverseDistance)));
+					}
+					else
+					{
+						// Some of the points step off the edge.
+						float laneHorizons[4];
+						_mm_storeu_ps(laneHorizons, horizon);
+						for (int lane = 0; lane < 4; lane++)
+						{
+							if (sampleZ + lane >= 0 && sampleZ + lane < edgeLength)
+							{
+								laneHorizons[lane] = max(laneHorizons[lane],
+										(heightMap[sampleX][sampleZ + lane] - row[z + lane]) * step.inverseDistance);
+							}
+						}
+						horizon = _mm_loadu_ps(laneHorizons);
+					}
+				}
+
+				_mm_storeu_ps(&horizons[z], horizon);
+			}
+#endif
+
+			for (; z < edgeLength; z++)
+			{
+				horizons[z] = getHorizon(heightMap, x, z, ray);
+			}
+		}
+	}
+}
@@ -0,0 +1,70 @@
+/*
+ * Copyright © 2014 Simple Entertainment Limited
+ *
+ * This file is part of The Island.
+ *
+ * The Island is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * The Island is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with The Island. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#ifndef TERRAINLIGHTING_H_
+#define TERRAINLIGHTING_H_
+
+#include <vector>
+
+#include <simplicity/API.h>
+
+#include "Arena.h"
+
+namespace theisland
+{
+	/**
+	 * <p>
+	 * Bakes the lighting of the terrain from its height map: ambient occlusion from how high the horizon is around
+	 * each point and shadows from whether the horizon towards the sun is above it.
+	 * </p>
+	 */
+	namespace TerrainLighting
+	{
+		struct SIMPLE_API Settings
+		{
+			// The number of directions the horizon is searched in for the ambient occlusion.
+			unsigned int directionCount = 8;
+
+			// How dark fully occluded terrain is (0 for no ambient occlusion).
+			float occlusionStrength = 0.6f;
+
+			// How far the horizon is searched (in height map cells).
+			float searchDistance = 32.0f;
+
+			// How dark terrain in the shadow of the sun is (0 for no shadows).
+			float shadowStrength = 0.5f;
+
+			// The direction towards the sun.
+			simplicity::Vector3 sunDirection = simplicity::Vector3(0.6f, 0.5f, 0.3f);
+		};
+
+		// Calculates how lit each point of the height map is (0 to 1). The rows are spread across the hardware
+		// threads.
+		SIMPLE_API void bake(const std::vector<std::vector<float>>& heightMap, const Settings& settings,
+				ArenaMap& lightMap);
+
+		// Calculates how lit the rows [minX, maxX) of the height map are on this thread, for hosts that bake a few
+		// rows at a time. The light map is sized when it is empty. The rows are lit the same as bake lights them.
+		SIMPLE_API void bakeRows(const std::vector<std::vector<float>>& heightMap, const Settings& settings,
+				unsigned int minX, unsigned int maxX, ArenaMap& lightMap);
+
+		// Interpolates the light map between its points. The light is rounded to a few levels so that lit terrain
+		// colors still fit in the palette of a CompactMesh.
+		SIMPLE_API float getLight(const ArenaMap& lightMap, float x, float z);
+	}
+}
+
+#endif /* TERRAINLIGHTING_H_ */
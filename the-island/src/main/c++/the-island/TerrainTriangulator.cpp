@@ -0,0 +1,232 @@
+/*
+ * Copyright © 2014 Simple Entertainment Limited
+ *
+ * This file is part of The Island.
+ *
+ * The Island is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * The Island is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with The Island. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include "TerrainTriangulator.h"
+
+using namespace simplicity;
+using namespace std;
+
+namespace theisland
+{
+	namespace TerrainTriangulator
+	{
+		void addTriangle(const GridPoint& a, const GridPoint& b, const GridPoint& c, ArenaVector<GridPoint>& triangles);
+		unsigned int getDepth(unsigned int chunkSize);
+		void getTriangle(unsigned int id, unsigned int chunkSize, GridPoint& a, GridPoint& b, GridPoint& c);
+		GridPoint getMidpoint(const GridPoint& a, const GridPoint& b);
+		void processTriangle(const ArenaMap& errorMap, const GridPoint& a, const GridPoint& b, const GridPoint& c,
+				unsigned int level, unsigned int levelCount, float maxError, ArenaVector<GridPoint>& triangles);
+
+		void addTriangle(const GridPoint& a, const GridPoint& b, const GridPoint& c, ArenaVector<GridPoint>& triangles)
+		{
+			triangles.push_back(a);
+
+			// Wind the triangle so that its normal points up.
+			int edge0X = static_cast<int>(b.x) - static_cast<int>(a.x);
+			int edge0Z = static_cast<int>(b.z) - static_cast<int>(a.z);
+			int edge1X = static_cast<int>(c.x) - static_cast<int>(a.x);
+			int edge1Z = static_cast<int>(c.z) - static_cast<int>(a.z);
+			int winding = edge0Z * edge1X - edge0X * edge1Z;
+			if (winding > 0)
+			{
+				triangles.push_back(b);
+				triangles.push_back(c);
+			}
+			else
+			{
+				triangles.push_back(c);
+				triangles.push_back(b);
+			}
+		}
+
+		void calculateErrors(const vector<vector<float>>& heightMap, unsigned int chunkSize, ArenaMap& errorMap)
+		{
+			unsigned int stepCount = getErrorStepCount(heightMap.size(), chunkSize);
+			for (unsigned int step = 0; step < stepCount; step++)
+			{
+				calculateErrorStep(heightMap, chunkSize, step, errorMap);
+			}
+		}
+
+		void calculateErrorStep(const vector<vector<float>>& heightMap, unsigned int chunkSize, unsigned int step,
+				ArenaMap& errorMap)
+		{
+			unsigned int edgeLength = heightMap.size();
+			unsigned int chunksPerEdge = (edgeLength - 1) / chunkSize;
+
+			if (step == 0)
+			{
+				errorMap.assign(edgeLength, ArenaVector<float>(edgeLength, 0.0f, errorMap.get_allocator()));
+			}
+
+			unsigned int levelCount = getDepth(chunkSize) * 2;
+			if (chunksPerEdge == 0 || step / chunksPerEdge >= levelCount)
+			{
+				return;
+			}
+
+			// Each level of the triangle tree has its own range of IDs. The levels are processed from the smallest
+			// triangles up across all chunks so that the errors merged into the shared chunk edges are propagated to
+			// the larger triangles on both sides.
+			unsigned int level = levelCount - step / chunksPerEdge;
+			unsigned int chunkX = step % chunksPerEdge;
+
+			for (unsigned int chunkZ = 0; chunkZ < chunksPerEdge; chunkZ++)
+			{
+				for (unsigned int id = 1u << level; id < 1u << (level + 1); id++)
+				{
+					GridPoint a;
+					GridPoint b;
+					GridPoint c;
+					getTriangle(id, chunkSize, a, b, c);
+
+					a.x += chunkX * chunkSize;
+					a.z += chunkZ * chunkSize;
+					b.x += chunkX * chunkSize;
+					b.z += chunkZ * chunkSize;
+					c.x += chunkX * chunkSize;
+					c.z += chunkZ * chunkSize;
+
+					GridPoint middle = getMidpoint(a, b);
+					float interpolatedHeight = (heightMap[a.x][a.z] + heightMap[b.x][b.z]) / 2.0f;
+					float error = fabs(interpolatedHeight - heightMap[middle.x][middle.z]);
+
+					// The triangles of the last level have no children (their midpoints are the last grid points).
+					if (level < levelCount)
+					{
+						GridPoint leftChild = getMidpoint(a, c);
+						GridPoint rightChild = getMidpoint(b, c);
+						error = max(error, max(errorMap[leftChild.x][leftChild.z],
+								errorMap[rightChild.x][rightChild.z]));
+					}
+
+					errorMap[middle.x][middle.z] = max(errorMap[middle.x][middle.z], error);
+				}
+			}
+		}
+
+		unsigned int getDepth(unsigned int chunkSize)
+		{
+			unsigned int depth = 0;
+			while ((1u << depth) < chunkSize)
+			{
+				depth++;
+			}
+
+			return depth;
+		}
+
+		unsigned int getErrorStepCount(unsigned int edgeLength, unsigned int chunkSize)
+		{
+			// One level of one row of chunks per step (and at least one step to size the error map).
+			return max(1u, getDepth(chunkSize) * 2 * ((edgeLength - 1) / chunkSize));
+		}
+
+		GridPoint getMidpoint(const GridPoint& a, const GridPoint& b)
+		{
+			GridPoint midpoint;
+			midpoint.x = (a.x + b.x) / 2;
+			midpoint.z = (a.z + b.z) / 2;
+
+			return midpoint;
+		}
+
+		void getTriangle(unsigned int id, unsigned int chunkSize, GridPoint& a, GridPoint& b, GridPoint& c)
+		{
+			// The lowest bit chooses between the two halves of the chunk...
+			if (id & 1)
+			{
+				a.x = 0;
+				a.z = 0;
+				b.x = chunkSize;
+				b.z = chunkSize;
+				c.x = chunkSize;
+				c.z = 0;
+			}
+			else
+			{
+				a.x = chunkSize;
+				a.z = chunkSize;
+				b.x = 0;
+				b.z = 0;
+				c.x = 0;
+				c.z = chunkSize;
+			}
+
+			// ... and each higher bit chooses between the two halves of the triangle.
+			while ((id >>= 1) > 1)
+			{
+				GridPoint middle = getMidpoint(a, b);
+
+				if (id & 1)
+				{
+					b = a;
+					a = c;
+				}
+				else
+				{
+					a = b;
+					b = c;
+				}
+
+				c = middle;
+			}
+		}
+
+		bool isAdaptive(unsigned int chunkSize)
+		{
+			return chunkSize > 0 && (chunkSize & (chunkSize - 1)) == 0;
+		}
+
+		void processTriangle(const ArenaMap& errorMap, const GridPoint& a, const GridPoint& b, const GridPoint& c,
+				unsigned int level, unsigned int levelCount, float maxError, ArenaVector<GridPoint>& triangles)
+		{
+			GridPoint middle = getMidpoint(a, b);
+
+			// Triangles up to the last level with errors have a midpoint on the grid to be split at.
+			if (level <= levelCount && errorMap[middle.x][middle.z] > maxError)
+			{
+				processTriangle(errorMap, c, a, middle, level + 1, levelCount, maxError, triangles);
+				processTriangle(errorMap, b, c, middle, level + 1, levelCount, maxError, triangles);
+			}
+			else
+			{
+				addTriangle(a, b, c, triangles);
+			}
+		}
+
+		void triangulate(const ArenaMap& errorMap, unsigned int minX, unsigned int minZ, unsigned int chunkSize,
+				float maxError, ArenaVector<GridPoint>& triangles)
+		{
+			GridPoint corner00;
+			corner00.x = minX;
+			corner00.z = minZ;
+			GridPoint corner01;
+			corner01.x = minX;
+			corner01.z = minZ + chunkSize;
+			GridPoint corner10;
+			corner10.x = minX + chunkSize;
+			corner10.z = minZ;
+			GridPoint corner11;
+			corner11.x = minX + chunkSize;
+			corner11.z = minZ + chunkSize;
+
+			unsigned int levelCount = getDepth(chunkSize) * 2;
+			processTriangle(errorMap, corner00, corner11, corner10, 1, levelCount, maxError, triangles);
+			processTriangle(errorMap, corner11, corner00, corner01, 1, levelCount, maxError, triangles);
+		}
+	}
+}
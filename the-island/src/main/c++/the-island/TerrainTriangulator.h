@@ -0,0 +1,59 @@
+/*
+ * Copyright © 2014 Simple Entertainment Limited
+ *
+ * This file is part of The Island.
+ *
+ * The Island is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * The Island is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with The Island. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#ifndef TERRAINTRIANGULATOR_H_
+#define TERRAINTRIANGULATOR_H_
+
+#include <simplicity/API.h>
+
+#include "Arena.h"
+
+namespace theisland
+{
+	namespace TerrainTriangulator
+	{
+		struct GridPoint
+		{
+			unsigned int x;
+
+			unsigned int z;
+		};
+
+		// Calculates the errors used to adaptively triangulate (RTIN) the chunks of a height map. Errors on the
+		// edges shared by neighbouring chunks are merged so that chunks triangulated with the same maximum error
+		// line up without cracks.
+		void calculateErrors(const std::vector<std::vector<float>>& heightMap, unsigned int chunkSize,
+				ArenaMap& errorMap);
+
+		// Calculates the errors of one level of the triangles of one row of chunks, for hosts that calculate them a
+		// step at a time. Taking every step in order calculates the same errors as calculateErrors does.
+		void calculateErrorStep(const std::vector<std::vector<float>>& heightMap, unsigned int chunkSize,
+				unsigned int step, ArenaMap& errorMap);
+
+		// The number of steps it takes to calculate the errors a step at a time.
+		unsigned int getErrorStepCount(unsigned int edgeLength, unsigned int chunkSize);
+
+		// Only chunks with a power of two edge length can be triangulated adaptively.
+		bool isAdaptive(unsigned int chunkSize);
+
+		// Appends the corners of the triangles needed to keep the chunk within the maximum error, three per
+		// triangle, wound the same way as the triangles of the height map mesh.
+		void triangulate(const ArenaMap& errorMap, unsigned int minX, unsigned int minZ, unsigned int chunkSize,
+				float maxError, ArenaVector<GridPoint>& triangles);
+	}
+}
+
+#endif /* TERRAINTRIANGULATOR_H_ */
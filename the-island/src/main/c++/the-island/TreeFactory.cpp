@@ -14,6 +14,8 @@
  * You should have received a copy of the GNU General Public License along with The Island. If not, see
  * <http://www.gnu.org/licenses/>.
  */
+#include "EntityCategories.h"
+#include "StagingBuffer.h"
 #include "TreeFactory.h"
 
 using namespace simplicity;
@@ -28,6 +30,8 @@ namespace theisland
 
 		const unsigned int TRUNK_COUNT = 5;
 
+		const unsigned int IMPOSTOR_RESOLUTION = 64;
+
 		const unsigned int VERTICES_IN_TRUNK_SEGMENT = SEGMENT_DIVISIONS * 4;
 		const unsigned int VERTICES_IN_TRUNK_SEGMENTS = VERTICES_IN_TRUNK_SEGMENT * SEGMENTS;
 		const unsigned int VERTICES_IN_TRUNK_TOP = SEGMENT_DIVISIONS + 1;
@@ -44,18 +48,31 @@ namespace theisland
 
 		vector<shared_ptr<Model>> bounds;
 
+		vector<CollisionProxy> collisionProxies;
+
+		shared_ptr<ImpostorAtlas> impostorAtlas;
+
+		ImpostorLod impostorLod;
+
 		vector<shared_ptr<Mesh>> leaves;
 
+		// Where the branches (and leaves) originate from on each trunk.
+		Vector3 segmentCenters[TRUNK_COUNT][SEGMENTS];
+
 		vector<shared_ptr<Mesh>> trunks;
 
 		unique_ptr<Entity> createBranch(const Vector3& position, float angleY, float scale);
-		shared_ptr<Mesh> createLeaf(const Mesh& branch, shared_ptr<MeshBuffer> buffer);
-		shared_ptr<Mesh> createTrunk(shared_ptr<MeshBuffer> buffer);
+		void createLeaf(const Vector3* segmentCenters, MeshData& leafData);
+		void createTrunk(MeshData& trunkData);
 		void createTrunks();
+		void insertBranchVertices(const MeshData& meshData, const Vector3& position, float angleY, float scale,
+				vector<Vertex>& vertices);
+		void insertVertices(const MeshData& meshData, vector<Vertex>& vertices);
+		void renderImpostor(unsigned int index, const MeshData& trunkData, const MeshData& leafData);
 
 		unique_ptr<Entity> createBranch(const Vector3& position, float angleY, float scale)
 		{
-			unique_ptr<Entity> branch(new Entity);
+			unique_ptr<Entity> branch(new Entity(EntityCategories::FOLIAGE_BRANCH));
 
 			unsigned int treeIndex = getRandomInt(0, TRUNK_COUNT - 1);
 			shared_ptr<Mesh> trunk = trunks[treeIndex];
@@ -78,38 +95,15 @@ namespace theisland
 			return move(branch);
 		}
 
-		shared_ptr<Mesh> createLeaf(const Mesh& branch, shared_ptr<MeshBuffer> buffer)
+		void createLeaf(const Vector3* segmentCenters, MeshData& leafData)
 		{
-			if (buffer == nullptr)
-			{
-				buffer = ModelFactory::getInstance()->createMeshBuffer(VERTICES_IN_LEAF, INDICES_IN_LEAF);
-			}
-
-			// Copy the branch vertex data to a local vector... argggh!
-			// I think it would have been OK at the moment but if we put the branch and the leaf in the same buffer...
-			// there be dragons!
-			const MeshData& branchData = branch.getData();
-			vector<Vertex> branchVertices(branchData.vertexCount);
-			memcpy(branchVertices.data(), branchData.vertexData, branchData.vertexCount * sizeof(Vertex));
-			branch.releaseData();
-
-			unique_ptr<Mesh> leaf(new Mesh(buffer));
-			MeshData& leafData = leaf->getData(false);
-
 			// Vertices
 			leafData.vertexCount = VERTICES_IN_LEAF;
 
 			for (unsigned int segment = 0; segment < SEGMENTS; segment++)
 			{
-				// Find the center of the segment because that's where we want the leaves to originate from.
-				Vector3 segmentCenter(0.0f, 0.0f, 0.0f);
-				unsigned int indexOffset = segment * VERTICES_IN_TRUNK_SEGMENT;
-
-				for (unsigned int index = indexOffset; index < indexOffset + VERTICES_IN_TRUNK_SEGMENT; index++)
-				{
-					segmentCenter += branchVertices[index].position;
-				}
-				segmentCenter /= static_cast<float>(VERTICES_IN_TRUNK_SEGMENT);
+				// The leaves originate from the center of the segment.
+				const Vector3& segmentCenter = segmentCenters[segment];
 
 				float scale = (1.0f - ((float) segment / SEGMENTS)) * 0.5f;
 
@@ -134,13 +128,18 @@ namespace theisland
 				ModelFactory::insertTriangleIndices(leafData.indexData, segment * 12 + 6, segment * 6 + 3);
 				ModelFactory::insertTriangleIndices(leafData.indexData, segment * 12 + 9, segment * 6 + 3, true);
 			}
+		}
 
-			leaf->releaseData();
+		CollisionProxy createTree(const Vector3& position)
+		{
+			SceneBatch batch;
+			CollisionProxy proxy = createTree(position, batch);
+			batch.commit();
 
-			return shared_ptr<Mesh>(move(leaf));
+			return proxy;
 		}
 
-		void createTree(const Vector3& position)
+		CollisionProxy createTree(const Vector3& position, SceneBatch& batch)
 		{
 			if (trunks.empty())
 			{
@@ -149,57 +148,48 @@ namespace theisland
 
 			unsigned int treeIndex = getRandomInt(0, TRUNK_COUNT - 1);
 			shared_ptr<Mesh> trunk = trunks[treeIndex];
-			const MeshData& trunkData = trunk->getData();
 
 			// Add branches
-			vector<unique_ptr<Entity>> branches;
+			unique_ptr<Entity> branches[SEGMENTS * 3];
+			vector<Entity*> rawBranches;
+			rawBranches.reserve(SEGMENTS * 3);
 			for (unsigned int segment = 0; segment < SEGMENTS; segment++)
 			{
-				// Find the center of the segment because that's where we want the branches to originate from.
-				Vector3 segmentCenter(0.0f, 0.0f, 0.0f);
-				unsigned int indexOffset = segment * VERTICES_IN_TRUNK_SEGMENT;
-
-				for (unsigned int index = indexOffset; index < indexOffset + VERTICES_IN_TRUNK_SEGMENT; index++)
-				{
-					segmentCenter += trunkData.vertexData[index].position;
-				}
-				segmentCenter /= static_cast<float>(VERTICES_IN_TRUNK_SEGMENT);
+				// The branches originate from the center of the segment.
+				const Vector3& segmentCenter = segmentCenters[treeIndex][segment];
 
 				float angleY = MathConstants::PI * getRandomFloat(0.0f, 2.0f);
 				float scale = (1.0f - ((float) segment / SEGMENTS)) * 0.5f;
 				for (unsigned int branch = 0; branch < 3; branch++)
 				{
-					branches.push_back(move(createBranch(position + segmentCenter, angleY, scale)));
+					branches[segment * 3 + branch] = createBranch(position + segmentCenter, angleY, scale);
+					rawBranches.push_back(branches[segment * 3 + branch].get());
 					angleY += MathConstants::PI * 2.0f / 3.0f;
 				}
 			}
 
-			trunk->releaseData();
-
 			// Assemble the tree!
-			unique_ptr<Entity> tree(new Entity);
+			unique_ptr<Entity> tree(new Entity(EntityCategories::FOLIAGE_TREE));
 			Entity* rawTree = tree.get();
+			impostorLod.add(*tree, rawBranches, treeIndex, position);
 			setPosition(tree->getTransform(), position);
 			tree->addSharedComponent(trunk);
 			tree->addSharedComponent(bounds[treeIndex]);
-			Simplicity::getScene()->addEntity(move(tree));
+			batch.add(move(tree));
 
-			for (unsigned int index = 0; index < branches.size(); index++)
+			for (unique_ptr<Entity>& branch : branches)
 			{
-				Simplicity::getScene()->addEntity(move(branches[index]), *rawTree);
+				batch.add(move(branch), rawTree);
 			}
-		}
 
-		shared_ptr<Mesh> createTrunk(shared_ptr<MeshBuffer> buffer)
-		{
-			if (buffer == nullptr)
-			{
-				buffer = ModelFactory::getInstance()->createMeshBuffer(VERTICES_IN_TRUNK, INDICES_IN_TRUNK);
-			}
+			CollisionProxy proxy = collisionProxies[treeIndex];
+			proxy.position = position;
 
-			unique_ptr<Mesh> trunk(new Mesh(buffer));
-			MeshData& trunkData = trunk->getData(false);
+			return proxy;
+		}
 
+		void createTrunk(MeshData& trunkData)
+		{
 			Vector4 color(0.47f, 0.24f, 0.0f, 1.0f);
 
 			float segmentHeight = 2.5f;
@@ -211,7 +201,6 @@ namespace theisland
 			trunkData.vertexCount = VERTICES_IN_TRUNK;
 
 			// Trunk Sides
-			vector<unique_ptr<Entity>> branches;
 			Vector3 center(0.0f, 0.0f, 0.0f);
 			for (unsigned int segment = 0; segment < SEGMENTS; segment++)
 			{
@@ -270,34 +259,144 @@ namespace theisland
 			// Trunk Top
 			ModelFactory::insertCircleIndices(trunkData.indexData, INDICES_IN_TRUNK_SEGMENTS,
 					VERTICES_IN_TRUNK_SEGMENTS, SEGMENT_DIVISIONS, true);
-
-			trunk->releaseData();
-
-			return shared_ptr<Mesh>(move(trunk));
 		}
 
 		void createTrunks()
 		{
-			unsigned int vertexCount = VERTICES_IN_TRUNK * TRUNK_COUNT + VERTICES_IN_LEAF * TRUNK_COUNT;
-			unsigned int indexCount = INDICES_IN_TRUNK * TRUNK_COUNT + INDICES_IN_LEAF * TRUNK_COUNT;
-			shared_ptr<MeshBuffer> trunkBuffer =
-					ModelFactory::getInstance()->createMeshBuffer(vertexCount, indexCount);
+			// The trunks and leaves are built in memory and then uploaded into one buffer together.
+			StagingBuffer staging;
 
-			trunks.reserve(TRUNK_COUNT);
 			for (unsigned int index = 0; index < TRUNK_COUNT; index++)
 			{
-				shared_ptr<Mesh> trunk = createTrunk(trunkBuffer);
-				shared_ptr<Mesh> leaf = createLeaf(*trunk, trunkBuffer);
+				MeshData& trunkData = staging.stage(VERTICES_IN_TRUNK, INDICES_IN_TRUNK);
+				createTrunk(trunkData);
 
-				const MeshData& trunkData = trunk->getData();
 				shared_ptr<Model> bound =
 					ModelFunctions::getCircleBoundsXZ(trunkData.vertexData, trunkData.vertexCount);
-				trunk->releaseData();
 
-				trunks.push_back(trunk);
-				leaves.push_back(leaf);
+				// The proxy is as wide as the base of the trunk and as tall as the whole trunk.
+				CollisionProxy collisionProxy;
+				collisionProxy.height = 0.0f;
+				collisionProxy.radius = 0.0f;
+				for (unsigned int vertexIndex = 0; vertexIndex < trunkData.vertexCount; vertexIndex++)
+				{
+					const Vector3& position = trunkData.vertexData[vertexIndex].position;
+					collisionProxy.height = max(collisionProxy.height, position.Y());
+
+					if (vertexIndex < VERTICES_IN_TRUNK_SEGMENT)
+					{
+						collisionProxy.radius = max(collisionProxy.radius,
+								sqrt(position.X() * position.X() + position.Z() * position.Z()));
+					}
+				}
+
+				for (unsigned int segment = 0; segment < SEGMENTS; segment++)
+				{
+					Vector3& segmentCenter = segmentCenters[index][segment];
+					segmentCenter = Vector3(0.0f, 0.0f, 0.0f);
+					unsigned int indexOffset = segment * VERTICES_IN_TRUNK_SEGMENT;
+
+					for (unsigned int vertexIndex = indexOffset; vertexIndex < indexOffset + VERTICES_IN_TRUNK_SEGMENT;
+							vertexIndex++)
+					{
+						segmentCenter += trunkData.vertexData[vertexIndex].position;
+					}
+					segmentCenter /= static_cast<float>(VERTICES_IN_TRUNK_SEGMENT);
+				}
+
+				createLeaf(segmentCenters[index], staging.stage(VERTICES_IN_LEAF, INDICES_IN_LEAF));
+
 				bounds.push_back(bound);
+				collisionProxies.push_back(collisionProxy);
+			}
+
+			impostorAtlas.reset(new ImpostorAtlas(TRUNK_COUNT, IMPOSTOR_RESOLUTION));
+			for (unsigned int index = 0; index < TRUNK_COUNT; index++)
+			{
+				renderImpostor(index, staging.getData(index * 2), staging.getData(index * 2 + 1));
 			}
+			impostorLod.setAtlas(impostorAtlas);
+
+			vector<unique_ptr<Mesh>> meshes = staging.upload(Buffer::AccessHint::NONE);
+
+			trunks.reserve(TRUNK_COUNT);
+			leaves.reserve(TRUNK_COUNT);
+			for (unsigned int index = 0; index < TRUNK_COUNT; index++)
+			{
+				trunks.push_back(shared_ptr<Mesh>(move(meshes[index * 2])));
+				leaves.push_back(shared_ptr<Mesh>(move(meshes[index * 2 + 1])));
+			}
+		}
+
+		unsigned int getEntityCount()
+		{
+			return 1 + SEGMENTS * 3;
+		}
+
+		shared_ptr<const ImpostorAtlas> getImpostorAtlas()
+		{
+			if (trunks.empty())
+			{
+				createTrunks();
+			}
+
+			return impostorAtlas;
+		}
+
+		ImpostorLod& getImpostorLod()
+		{
+			return impostorLod;
+		}
+
+		void insertBranchVertices(const MeshData& meshData, const Vector3& position, float angleY, float scale,
+				vector<Vertex>& vertices)
+		{
+			// The same transform createBranch gives its entity: tilted about X, turned about Y, scaled and moved.
+			float tilt = MathConstants::PI * 0.65f;
+			unsigned int firstIndex = vertices.size();
+			insertVertices(meshData, vertices);
+
+			for (unsigned int index = firstIndex; index < vertices.size(); index++)
+			{
+				for (Vector3* vector : { &vertices[index].position, &vertices[index].normal })
+				{
+					Vector3 tilted(vector->X(), vector->Y() * cos(tilt) - vector->Z() * sin(tilt),
+							vector->Y() * sin(tilt) + vector->Z() * cos(tilt));
+					*vector = Vector3(tilted.X() * cos(angleY) + tilted.Z() * sin(angleY), tilted.Y(),
+							-tilted.X() * sin(angleY) + tilted.Z() * cos(angleY));
+				}
+
+				vertices[index].position = vertices[index].position * scale + position;
+			}
+		}
+
+		void insertVertices(const MeshData& meshData, vector<Vertex>& vertices)
+		{
+			for (unsigned int index = 0; index < meshData.indexCount; index++)
+			{
+				vertices.push_back(meshData.vertexData[meshData.indexData[index]]);
+			}
+		}
+
+		void renderImpostor(unsigned int index, const MeshData& trunkData, const MeshData& leafData)
+		{
+			// A tree of this kind with branches of the same kind, turned evenly instead of randomly.
+			vector<Vertex> triangles;
+			insertVertices(trunkData, triangles);
+
+			for (unsigned int segment = 0; segment < SEGMENTS; segment++)
+			{
+				float angleY = MathConstants::PI * 0.5f * segment;
+				float scale = (1.0f - ((float) segment / SEGMENTS)) * 0.5f;
+				for (unsigned int branch = 0; branch < 3; branch++)
+				{
+					insertBranchVertices(trunkData, segmentCenters[index][segment], angleY, scale, triangles);
+					insertBranchVertices(leafData, segmentCenters[index][segment], angleY, scale, triangles);
+					angleY += MathConstants::PI * 2.0f / 3.0f;
+				}
+			}
+
+			impostorAtlas->render(index, triangles);
 		}
 	}
 }
@@ -21,11 +21,27 @@
 
 #include <simplicity/API.h>
 
+#include "CollisionProxy.h"
+#include "ImpostorLod.h"
+#include "SceneBatch.h"
+
 namespace theisland
 {
 	namespace TreeFactory
 	{
-		SIMPLE_API void createTree(const simplicity::Vector3& position);
+		SIMPLE_API CollisionProxy createTree(const simplicity::Vector3& position);
+
+		// Adds the tree and its branches to the batch instead of the scene.
+		SIMPLE_API CollisionProxy createTree(const simplicity::Vector3& position, SceneBatch& batch);
+
+		// The number of entities a tree is made of (the tree and its branches).
+		SIMPLE_API unsigned int getEntityCount();
+
+		// Pictures of each kind of tree, for drawing distant trees.
+		SIMPLE_API std::shared_ptr<const ImpostorAtlas> getImpostorAtlas();
+
+		// Every tree created, for swapping distant trees for their impostors.
+		SIMPLE_API ImpostorLod& getImpostorLod();
 	}
 }
 
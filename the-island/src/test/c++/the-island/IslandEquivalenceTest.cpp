@@ -0,0 +1,383 @@
+/*
+ * Copyright © 2014 Simple Entertainment Limited
+ *
+ * This file is part of The Island.
+ *
+ * The Island is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * The Island is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with The Island. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <cinttypes>
+#include <cstdio>
+#include <map>
+#include <vector>
+
+#include <simplicity/API.h>
+
+#include <the-island/API.h>
+
+using namespace simplicity;
+using namespace std;
+using namespace theisland;
+
+// Both builds of every island are made from the engine's random numbers seeded with this.
+static const unsigned int SEED = 1234;
+
+// The budget (in microseconds) the reference builds are continued with. Any budget gives the same island, a small one
+// takes every step on its own.
+static const unsigned int REFERENCE_BUDGET = 1;
+
+namespace
+{
+	// Keeps the meshes in memory so that no window or graphics context is needed.
+	class HeadlessMeshBuffer : public MeshBuffer
+	{
+		public:
+			HeadlessMeshBuffer(Buffer::AccessHint accessHint) :
+				accessHint(accessHint),
+				meshes()
+			{
+			}
+
+			void allocateMesh(Mesh& mesh, unsigned int vertexCount, unsigned int indexCount)
+			{
+				HeadlessMesh& headlessMesh = meshes[&mesh];
+				headlessMesh.indices.resize(indexCount);
+				headlessMesh.vertices.resize(vertexCount);
+				headlessMesh.data.indexCount = indexCount;
+				headlessMesh.data.indexData = headlessMesh.indices.data();
+				headlessMesh.data.vertexCount = vertexCount;
+				headlessMesh.data.vertexData = headlessMesh.vertices.data();
+			}
+
+			void freeMesh(const Mesh& mesh)
+			{
+				meshes.erase(&mesh);
+			}
+
+			Buffer::AccessHint getAccessHint() const
+			{
+				return accessHint;
+			}
+
+			unsigned int getBaseIndex(const Mesh&) const
+			{
+				return 0;
+			}
+
+			unsigned int getBaseVertex(const Mesh&) const
+			{
+				return 0;
+			}
+
+			MeshData& getData(const Mesh& mesh, bool, bool)
+			{
+				return meshes[&mesh].data;
+			}
+
+			const MeshData& getData(const Mesh& mesh) const
+			{
+				return meshes.at(&mesh).data;
+			}
+
+			bool isIndexed() const
+			{
+				return true;
+			}
+
+			void releaseData(const Mesh&) const
+			{
+			}
+
+		private:
+			struct HeadlessMesh
+			{
+				MeshData data;
+
+				vector<unsigned int> indices;
+
+				vector<Vertex> vertices;
+			};
+
+			Buffer::AccessHint accessHint;
+
+			map<const Mesh*, HeadlessMesh> meshes;
+	};
+
+	class HeadlessModelFactory : public ModelFactory
+	{
+		public:
+			shared_ptr<MeshBuffer> createMeshBuffer(unsigned int, unsigned int, Buffer::AccessHint accessHint)
+			{
+				return shared_ptr<MeshBuffer>(new HeadlessMeshBuffer(accessHint));
+			}
+	};
+
+	// Does not take part in any simulation, the checksums only cover the meshes the bodies are made from.
+	class HeadlessBody : public Body
+	{
+		public:
+			HeadlessBody(const Body::Material& material, Model* model, const Matrix44& transform, bool dynamic) :
+				dynamic(dynamic),
+				material(material),
+				model(model),
+				transform(transform)
+			{
+			}
+
+			void applyForce(const Vector3&, const Vector3&)
+			{
+			}
+
+			void applyTorque(const Vector3&)
+			{
+			}
+
+			void clearForces()
+			{
+			}
+
+			Vector3 getAngularVelocity() const
+			{
+				return Vector3(0.0f, 0.0f, 0.0f);
+			}
+
+			Vector3 getLinearVelocity() const
+			{
+				return Vector3(0.0f, 0.0f, 0.0f);
+			}
+
+			const Body::Material& getMaterial() const
+			{
+				return material;
+			}
+
+			const Model* getModel() const
+			{
+				return model;
+			}
+
+			Matrix44 getTransform() const
+			{
+				return transform;
+			}
+
+			bool isDynamic()
+			{
+				return dynamic;
+			}
+
+			void setAngularVelocity(const Vector3&)
+			{
+			}
+
+			void setLinearVelocity(const Vector3&)
+			{
+			}
+
+			void setMaterial(const Body::Material& material)
+			{
+				this->material = material;
+			}
+
+			void setModel(const Model* model)
+			{
+				this->model = model;
+			}
+
+			void setTransform(const Matrix44& transform)
+			{
+				this->transform = transform;
+			}
+
+		private:
+			bool dynamic;
+
+			Body::Material material;
+
+			const Model* model;
+
+			Matrix44 transform;
+	};
+
+	class HeadlessPhysicsFactory : public PhysicsFactory
+	{
+		public:
+			unique_ptr<Body> createBody(const Body::Material& material, Model* model, const Matrix44& transform,
+					bool dynamic)
+			{
+				return unique_ptr<Body>(new HeadlessBody(material, model, transform, dynamic));
+			}
+	};
+
+	struct Configuration
+	{
+		unsigned int chunkSize;
+
+		const char* name;
+
+		IslandFactory::Settings settings;
+	};
+
+	vector<Configuration> getConfigurations();
+	vector<float> getProfile();
+	bool readChecksums(FILE* file, Checksums::IslandChecksums& checksums);
+	void writeChecksums(FILE* file, const Checksums::IslandChecksums& checksums);
+
+	vector<Configuration> getConfigurations()
+	{
+		vector<Configuration> configurations(4);
+
+		configurations[0].name = "default";
+		configurations[0].chunkSize = 16;
+
+		configurations[1].name = "noise, erosion and lighting";
+		configurations[1].chunkSize = 16;
+		configurations[1].settings.bakeLighting = true;
+		configurations[1].settings.erodeHeights = true;
+		configurations[1].settings.noiseHeights = true;
+
+		configurations[2].name = "adaptive terrain and cliff budget";
+		configurations[2].chunkSize = 16;
+		configurations[2].settings.adaptiveTerrain = true;
+		configurations[2].settings.cliffTriangleBudget = 500;
+		configurations[2].settings.oceanCutoffDepth = 3.0f;
+
+		configurations[3].name = "compact terrain and navigation";
+		configurations[3].chunkSize = 12;
+		configurations[3].settings.buildNavigation = true;
+		configurations[3].settings.compactTerrain = true;
+		configurations[3].settings.underwaterCollision = false;
+
+		for (Configuration& configuration : configurations)
+		{
+			// The two builds should be the same bit for bit.
+			configuration.settings.checksums = true;
+			configuration.settings.checksumTolerance = 0.0f;
+		}
+
+		return configurations;
+	}
+
+	vector<float> getProfile()
+	{
+		// A cone that drops below the water half way out.
+		vector<float> profile;
+		for (unsigned int distance = 0; distance <= 100; distance++)
+		{
+			profile.push_back(distance < 50 ? 30.0f * (1.0f - distance / 50.0f) - 2.0f : -5.0f);
+		}
+
+		return profile;
+	}
+
+	bool readChecksums(FILE* file, Checksums::IslandChecksums& checksums)
+	{
+		unsigned int chunkCount = 0;
+		if (fscanf(file, "%" SCNx64 " %" SCNx64 " %" SCNx64 " %" SCNx64 " %" SCNx64 " %" SCNx64 " %u",
+				&checksums.heightMap, &checksums.biomeColors, &checksums.foliageBodies, &checksums.grass,
+				&checksums.rocks, &checksums.trees, &chunkCount) != 7)
+		{
+			return false;
+		}
+
+		checksums.chunks.resize(chunkCount);
+		for (uint64_t& chunk : checksums.chunks)
+		{
+			if (fscanf(file, "%" SCNx64, &chunk) != 1)
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	void writeChecksums(FILE* file, const Checksums::IslandChecksums& checksums)
+	{
+		fprintf(file, "%" PRIx64 " %" PRIx64 " %" PRIx64 " %" PRIx64 " %" PRIx64 " %" PRIx64 " %u",
+				checksums.heightMap, checksums.biomeColors, checksums.foliageBodies, checksums.grass,
+				checksums.rocks, checksums.trees, static_cast<unsigned int>(checksums.chunks.size()));
+		for (uint64_t chunk : checksums.chunks)
+		{
+			fprintf(file, " %" PRIx64, chunk);
+		}
+		fprintf(file, "\n");
+	}
+}
+
+// Compiled twice. Built with THE_ISLAND_SCALAR (against the island built with it too) it is the reference: each island
+// is built a step at a time on one thread with the scalar kernels and its checksums are written to the file. Built
+// without it, each island is built all at once with the threaded and SIMD paths and fails if its checksums differ from
+// the reference's.
+int main(int argc, char** argv)
+{
+	if (argc != 2)
+	{
+		printf("Usage: %s <reference checksums file>\n", argv[0]);
+		return 2;
+	}
+
+#ifdef THE_ISLAND_SCALAR
+	FILE* file = fopen(argv[1], "w");
+#else
+	FILE* file = fopen(argv[1], "r");
+#endif
+	if (file == nullptr)
+	{
+		printf("Cannot open %s\n", argv[1]);
+		return 2;
+	}
+
+	ModelFactory::setInstance(unique_ptr<ModelFactory>(new HeadlessModelFactory));
+	PhysicsFactory::setInstance(unique_ptr<PhysicsFactory>(new HeadlessPhysicsFactory));
+	Simplicity::addScene(unique_ptr<Scene>(new Scene));
+
+	unsigned int radius = 48;
+	vector<float> profile = getProfile();
+	bool failed = false;
+
+	for (const Configuration& configuration : getConfigurations())
+	{
+		setRandomSeed(SEED);
+
+#ifdef THE_ISLAND_SCALAR
+		IslandFactory::beginIsland(radius, profile, configuration.chunkSize, configuration.settings);
+		while (!IslandFactory::continueIsland(REFERENCE_BUDGET))
+		{
+		}
+		writeChecksums(file, IslandFactory::getChecksums());
+		printf("%s: written\n", configuration.name);
+#else
+		Checksums::IslandChecksums reference;
+		if (!readChecksums(file, reference))
+		{
+			printf("%s: no reference\n", configuration.name);
+			failed = true;
+			break;
+		}
+
+		IslandFactory::createIsland(radius, profile, configuration.chunkSize, configuration.settings);
+
+		vector<string> differences = Checksums::compare(reference, IslandFactory::getChecksums());
+		printf("%s: %s\n", configuration.name, differences.empty() ? "same" : "different");
+		for (const string& difference : differences)
+		{
+			printf("\t%s\n", difference.c_str());
+		}
+
+		failed |= !differences.empty();
+#endif
+	}
+
+	fclose(file);
+
+	return failed ? 1 : 0;
+}